@@ -0,0 +1,321 @@
+// FILE: AsyncLogger.cpp
+#include "AsyncLogger.h"
+#include "WorkQueue.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+// Lines written per file write; also the upper bound between two flushes
+static const std::size_t MAX_BATCH = 1024;
+
+static std::tm localTime(std::time_t second) {
+    std::tm local;
+#ifdef _WIN32
+    localtime_s(&local, &second);
+#else
+    localtime_r(&second, &local);
+#endif
+    return local;
+}
+
+// year * 1000 + day of year, in local time
+static int localDay(const std::tm& local) {
+    return (local.tm_year + 1900) * 1000 + local.tm_yday;
+}
+
+// The local day an existing log was last written, or -1 if unknown
+static int lastWrittenDay(const std::string& path) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::file_time_type written = fs::last_write_time(path, error);
+    if (error) return -1;
+    // file_time_type has no portable conversion before C++20; go through both clocks' now()
+    std::chrono::system_clock::time_point when = std::chrono::system_clock::now() +
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(written - fs::file_time_type::clock::now());
+    return localDay(localTime(std::chrono::system_clock::to_time_t(when)));
+}
+
+// ============================================
+// Producer side
+// ============================================
+AsyncLogger::AsyncLogger(const std::string& logPath, const LogRotationPolicy& policy,
+                         std::size_t capacity)
+    : mask(0), enqueuePos(0), dequeuePos(0), writtenCount(0), droppedCount(0), rotationCount(0),
+      path(logPath), fileOpen(false), fileBytes(0), fileDay(-1), archiveSequence(0), rotation(policy),
+      stopping(false), sleeping(false), stampSecond(0), stampDay(-1), batchDay(-1), reportedDrops(0) {
+    std::size_t size = 2;
+    while (size < capacity) size <<= 1;
+    mask = size - 1;
+    slots.reset(new Slot[size]);
+    for (std::size_t i = 0; i < size; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    
+    file.open(path, std::ios::app);
+    fileOpen = file.is_open();
+    std::error_code error;
+    std::uintmax_t existing = std::filesystem::file_size(path, error);
+    fileBytes = error ? 0 : existing;
+    // A file left from an earlier day is rotated before the first new line
+    if (fileBytes > 0) fileDay = lastWrittenDay(path);
+    writer = std::thread(&AsyncLogger::run, this);
+}
+
+AsyncLogger::~AsyncLogger() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (writer.joinable()) writer.join();
+    // Lets pruning started by the last rotation finish
+    housekeeping.reset();
+}
+
+bool AsyncLogger::write(LogLevel level, std::string message) {
+    // Bounded MPMC queue (Vyukov): a slot is free for position pos when its
+    // sequence equals pos, and holds a line for the reader once it is pos + 1
+    std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots[pos & mask];
+        std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // The writer has not freed this slot yet: buffer full
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    
+    slot->level = level;
+    slot->time = std::chrono::system_clock::now();
+    slot->message = std::move(message);
+    // Only a parked writer needs the syscall. Both sides are seq_cst: the writer
+    // sets sleeping before it re-checks the slot, so one of the two sees the other.
+    slot->sequence.store(pos + 1, std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+    return true;
+}
+
+void AsyncLogger::flush() {
+    unsigned long long target = enqueuePos.load();
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wake.notify_one();
+    drained.wait(lock, [&]() { return writtenCount.load() >= target || stopping.load(); });
+}
+
+LoggerStats AsyncLogger::stats() const {
+    LoggerStats result;
+    result.written = writtenCount.load();
+    result.dropped = droppedCount.load();
+    result.rotations = rotationCount.load();
+    unsigned long long accepted = enqueuePos.load();
+    result.queued = accepted > result.written ? static_cast<std::size_t>(accepted - result.written) : 0;
+    return result;
+}
+
+void AsyncLogger::setRotationPolicy(const LogRotationPolicy& policy) {
+    std::lock_guard<std::mutex> lock(rotationMutex);
+    rotation = policy;
+}
+
+// ============================================
+// Writer thread
+// ============================================
+void AsyncLogger::updateStamp(std::chrono::system_clock::time_point time) {
+    // Lines arrive in bursts within the same second, so format the stamp once per second
+    std::time_t second = std::chrono::system_clock::to_time_t(time);
+    if (second != stampSecond || stamp.empty()) {
+        std::tm local = localTime(second);
+        char text[40];
+        std::size_t length = std::strftime(text, sizeof(text), "[%a %b %d %H:%M:%S %Y] ", &local);
+        stamp.assign(text, length);
+        stampSecond = second;
+        stampDay = localDay(local);
+    }
+}
+
+void AsyncLogger::appendLine(std::string& batch, LogLevel level,
+                             std::chrono::system_clock::time_point time, const std::string& message) {
+    updateStamp(time);
+    batch += stamp;
+    switch (level) {
+        case LogLevel::Debug: batch += "DEBUG: "; break;
+        case LogLevel::Warning: batch += "WARNING: "; break;
+        case LogLevel::Error: batch += "ERROR: "; break;
+        case LogLevel::Info: break;
+    }
+    batch += message;
+    batch += '\n';
+}
+
+std::size_t AsyncLogger::drainBatch(std::string& batch) {
+    std::size_t count = 0;
+    while (count < MAX_BATCH) {
+        Slot& slot = slots[dequeuePos & mask];
+        std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePos + 1) break;   // empty, or the producer is still filling it
+        
+        // A batch never spans midnight, so daily rotation splits the lines exactly
+        updateStamp(slot.time);
+        if (count == 0) batchDay = stampDay;
+        else if (stampDay != batchDay) break;
+        
+        appendLine(batch, slot.level, slot.time, slot.message);
+        slot.message.clear();
+        slot.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+        ++dequeuePos;
+        ++count;
+    }
+    
+    unsigned long long drops = droppedCount.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+        appendLine(batch, LogLevel::Warning, std::chrono::system_clock::now(),
+                   std::to_string(drops - reportedDrops) + " log messages dropped (buffer full)");
+        reportedDrops = drops;
+    }
+    return count;
+}
+
+void AsyncLogger::writeBatch(const std::string& batch) {
+    LogRotationPolicy policy;
+    {
+        std::lock_guard<std::mutex> lock(rotationMutex);
+        policy = rotation;
+    }
+    
+    if (file.is_open()) {
+        bool newDay = policy.daily && fileDay != -1 && batchDay != fileDay;
+        bool full = policy.maxBytes > 0 && fileBytes > 0 && fileBytes + batch.size() > policy.maxBytes;
+        if (newDay || full) rotate(policy);
+    }
+    if (fileDay == -1) fileDay = batchDay;
+    
+    if (file.is_open()) {
+        file.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+        file.flush();
+        fileBytes += batch.size();
+    }
+}
+
+void AsyncLogger::rotate(const LogRotationPolicy& policy) {
+    namespace fs = std::filesystem;
+    file.close();
+    
+    std::tm local = localTime(std::time(nullptr));
+    char suffix[24];
+    std::size_t length = std::strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &local);
+    std::string base = path + std::string(suffix, length);
+    // Several rotations in one second get -1, -2, ...; pruned names are not reused,
+    // nor names an outside job has since gzipped
+    if (base != archiveBase) {
+        archiveBase = base;
+        archiveSequence = 0;
+    }
+    std::string archive;
+    std::error_code error;
+    do {
+        archive = archiveSequence == 0 ? base : base + "-" + std::to_string(archiveSequence);
+        ++archiveSequence;
+    } while (fs::exists(archive, error) || fs::exists(archive + ".gz", error));
+    fs::rename(path, archive, error);
+    
+    // If the rename failed (file locked, say) keep appending rather than lose lines
+    file.open(path, std::ios::app);
+    fileOpen = file.is_open();
+    fileBytes = error ? fileBytes : 0;
+    fileDay = batchDay;
+    if (error) return;
+    ++rotationCount;
+    
+    if (policy.keepFiles == 0) return;
+    if (!housekeeping) housekeeping.reset(new WorkQueue(1));
+    std::size_t keepFiles = policy.keepFiles;
+    housekeeping->post([this, keepFiles]() { pruneRotated(keepFiles); });
+}
+
+void AsyncLogger::pruneRotated(std::size_t keepFiles) {
+    namespace fs = std::filesystem;
+    fs::path current(path);
+    fs::path directory = current.has_parent_path() ? current.parent_path() : fs::path(".");
+    std::string prefix = current.filename().string() + ".";
+    
+    // <file>.<yyyymmdd-hhmmss>[-n][.gz], ordered by stamp then n (oldest first)
+    struct Rotated {
+        std::string stamp;
+        long sequence;
+        fs::path file;
+        
+        bool operator<(const Rotated& other) const {
+            return stamp != other.stamp ? stamp < other.stamp : sequence < other.sequence;
+        }
+    };
+    const std::size_t stampLength = 15;   // yyyymmdd-hhmmss
+    std::vector<Rotated> rotated;
+    std::error_code error;
+    for (fs::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        std::string name = it->path().filename().string();
+        if (name.size() < prefix.size() + stampLength || name.compare(0, prefix.size(), prefix) != 0 ||
+            !std::isdigit(static_cast<unsigned char>(name[prefix.size()]))) {
+            continue;
+        }
+        Rotated entry;
+        entry.stamp = name.substr(prefix.size(), stampLength);
+        std::size_t rest = prefix.size() + stampLength;
+        entry.sequence = rest < name.size() && name[rest] == '-' ? std::strtol(name.c_str() + rest + 1, nullptr, 10) : 0;
+        entry.file = it->path();
+        rotated.push_back(entry);
+    }
+    if (rotated.size() <= keepFiles) return;
+    
+    std::sort(rotated.begin(), rotated.end());
+    for (std::size_t i = 0; i + keepFiles < rotated.size(); ++i) {
+        fs::remove(rotated[i].file, error);
+    }
+}
+
+void AsyncLogger::run() {
+    std::string batch;
+    for (;;) {
+        std::size_t count = drainBatch(batch);
+        if (!batch.empty()) {
+            writeBatch(batch);
+            batch.clear();
+        }
+        if (count > 0) {
+            writtenCount.fetch_add(count);
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            drained.notify_all();
+            continue;
+        }
+        
+        if (stopping) {
+            // A producer may have claimed a slot and not yet published its line
+            if (enqueuePos.load(std::memory_order_acquire) == dequeuePos) break;
+            std::this_thread::yield();
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        sleeping.store(true, std::memory_order_seq_cst);
+        // The timeout lets the writer report dropped lines while nothing new arrives
+        wake.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+            return stopping.load() || slots[dequeuePos & mask].sequence.load() == dequeuePos + 1;
+        });
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+    
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    drained.notify_all();
+}
@@ -0,0 +1,142 @@
+// FILE: AsyncLogger.h
+#ifndef ASYNCLOGGER_H
+#define ASYNCLOGGER_H
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <cstddef>
+#include <cstdint>
+
+enum class LogLevel {
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3
+};
+
+// Messages below this level are compiled out (0 = Debug ... 3 = Error).
+// Build with -DLIBRARY_LOG_MIN_LEVEL=0 to keep the per-query debug lines.
+#ifndef LIBRARY_LOG_MIN_LEVEL
+#define LIBRARY_LOG_MIN_LEVEL 1
+#endif
+
+constexpr bool logLevelEnabled(LogLevel level) {
+    return static_cast<int>(level) >= LIBRARY_LOG_MIN_LEVEL;
+}
+
+struct LoggerStats {
+    unsigned long long written;   // lines on disk
+    unsigned long long dropped;   // lines discarded because the buffer was full
+    unsigned long long rotations; // times the file was rotated
+    std::size_t queued;           // lines waiting for the writer thread
+    
+    LoggerStats() : written(0), dropped(0), rotations(0), queued(0) {}
+};
+
+// When the log file is closed and renamed to <file>.<yyyymmdd-hhmmss>.
+// Rotated files are not compressed here; an outside job (logrotate, a cron
+// or scheduled gzip) may do it, and <file>.<stamp>.gz still counts towards
+// keepFiles.
+struct LogRotationPolicy {
+    std::uintmax_t maxBytes;   // rotate before a batch would grow the file past this; 0 = never
+    bool daily;                // rotate on the first line of a new local day, also at startup
+                               // when the existing file was last written on an earlier day
+    std::size_t keepFiles;     // rotated files kept; older ones are deleted; 0 = keep all
+    
+    LogRotationPolicy() : maxBytes(10 * 1024 * 1024), daily(true), keepFiles(7) {}
+};
+
+class WorkQueue;
+
+// Log file fed through a bounded lock-free ring buffer. Any number of threads
+// may call write(); it never blocks and never touches the disk. One writer
+// thread formats timestamps, writes lines in batches and flushes once per
+// batch. When the buffer is full the new line is dropped and counted, and the
+// writer notes the loss in the file. Rotation also happens on the writer
+// thread; pruning old files runs on a separate one.
+class AsyncLogger {
+private:
+    struct Slot {
+        std::atomic<std::size_t> sequence;   // ring position this slot is ready for
+        LogLevel level;
+        std::chrono::system_clock::time_point time;
+        std::string message;
+    };
+    
+    std::unique_ptr<Slot[]> slots;
+    std::size_t mask;                             // capacity - 1 (capacity is a power of two)
+    alignas(64) std::atomic<std::size_t> enqueuePos;
+    alignas(64) std::size_t dequeuePos;           // writer thread only
+    
+    std::atomic<unsigned long long> writtenCount;
+    std::atomic<unsigned long long> droppedCount;
+    std::atomic<unsigned long long> rotationCount;
+    
+    std::string path;
+    std::ofstream file;                           // writer thread only after construction
+    std::atomic<bool> fileOpen;
+    std::uintmax_t fileBytes;                     // writer thread only
+    int fileDay;                                  // local day of the file's lines, writer thread only
+    std::string archiveBase;                      // last rotation's name without -n, writer thread only
+    int archiveSequence;                          // next -n for archiveBase, writer thread only
+    
+    LogRotationPolicy rotation;
+    std::mutex rotationMutex;                     // guards rotation; the writer copies it once per batch
+    std::unique_ptr<WorkQueue> housekeeping;      // prunes rotated files
+    std::thread writer;
+    std::mutex wakeMutex;                         // only for sleeping; write() takes it only to wake a parked writer
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::atomic<bool> stopping;
+    std::atomic<bool> sleeping;                   // the writer is parked on wake
+    
+    // Writer-thread state
+    std::time_t stampSecond;
+    std::string stamp;                            // "[Sat Oct 17 21:43:40 2026] " for stampSecond
+    int stampDay;                                 // local day of stampSecond (year * 1000 + day of year)
+    int batchDay;                                 // local day of every line in the current batch
+    unsigned long long reportedDrops;
+    
+    void run();
+    void updateStamp(std::chrono::system_clock::time_point time);
+    std::size_t drainBatch(std::string& batch);
+    void appendLine(std::string& batch, LogLevel level,
+                    std::chrono::system_clock::time_point time, const std::string& message);
+    void writeBatch(const std::string& batch);
+    void rotate(const LogRotationPolicy& policy);
+    void pruneRotated(std::size_t keepFiles);
+    
+public:
+    // Appends to logPath; capacity is rounded up to a power of two
+    explicit AsyncLogger(const std::string& logPath,
+                         const LogRotationPolicy& policy = LogRotationPolicy(),
+                         std::size_t capacity = 8192);
+    
+    // Writes everything still queued, then stops the writer thread
+    ~AsyncLogger();
+    
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+    
+    bool isOpen() const { return fileOpen.load(); }
+    
+    // False (and counted as dropped) if the buffer is full
+    bool write(LogLevel level, std::string message);
+    
+    // Blocks until every line queued before the call is on disk
+    void flush();
+    
+    LoggerStats stats() const;
+    
+    // Takes effect from the writer's next batch
+    void setRotationPolicy(const LogRotationPolicy& policy);
+};
+
+#endif // ASYNCLOGGER_H
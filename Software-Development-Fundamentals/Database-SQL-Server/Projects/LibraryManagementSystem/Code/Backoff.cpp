@@ -0,0 +1,17 @@
+// FILE: Backoff.cpp
+#include "Backoff.h"
+#include <algorithm>
+#include <random>
+
+std::chrono::milliseconds backoffDelay(const BackoffPolicy& policy, int retry) {
+    double delay = static_cast<double>(policy.initialDelay.count());
+    for (int i = 1; i < retry; ++i) {
+        delay *= policy.multiplier;
+        if (delay >= static_cast<double>(policy.maxDelay.count())) break;
+    }
+    delay = std::min(delay, static_cast<double>(policy.maxDelay.count()));
+    
+    thread_local std::mt19937 rng(std::random_device{}());
+    std::uniform_real_distribution<double> jitter(delay / 2.0, delay);
+    return std::chrono::milliseconds(static_cast<long long>(jitter(rng)));
+}
@@ -0,0 +1,22 @@
+// FILE: Backoff.h
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <chrono>
+
+// Exponential backoff with jitter, shared by reconnects and transaction retries
+struct BackoffPolicy {
+    int maxAttempts;                         // attempts before giving up, including the first
+    std::chrono::milliseconds initialDelay;  // delay before the second attempt
+    std::chrono::milliseconds maxDelay;      // cap on any single delay
+    double multiplier;                       // growth factor per attempt
+    
+    BackoffPolicy() : maxAttempts(6), initialDelay(200), maxDelay(10000), multiplier(2.0) {}
+};
+
+// Delay to sleep before the given retry (1 = first retry). The result is drawn
+// uniformly from [d/2, d] where d is the capped exponential delay, so clients
+// that failed together do not reconnect in lockstep.
+std::chrono::milliseconds backoffDelay(const BackoffPolicy& policy, int retry);
+
+#endif // BACKOFF_H
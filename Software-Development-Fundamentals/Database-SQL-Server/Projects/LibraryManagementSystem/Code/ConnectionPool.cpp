@@ -0,0 +1,249 @@
+// FILE: ConnectionPool.cpp
+#include "ConnectionPool.h"
+#include <algorithm>
+#include <utility>
+
+// ============================================
+// ConnectionLease
+// ============================================
+ConnectionLease::ConnectionLease(std::shared_ptr<ConnectionPool> owner,
+                                 std::unique_ptr<PooledConnection> pooled)
+    : pool(std::move(owner)), entry(std::move(pooled)), broken(false) {}
+
+ConnectionLease::ConnectionLease(ConnectionLease&& other) noexcept
+    : pool(std::move(other.pool)), entry(std::move(other.entry)), broken(other.broken) {
+    other.broken = false;
+}
+
+ConnectionLease& ConnectionLease::operator=(ConnectionLease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool = std::move(other.pool);
+        entry = std::move(other.entry);
+        broken = other.broken;
+        other.broken = false;
+    }
+    return *this;
+}
+
+ConnectionLease::~ConnectionLease() {
+    release();
+}
+
+nanodbc::connection& ConnectionLease::connection() {
+    return *entry->conn;
+}
+
+nanodbc::statement& ConnectionLease::prepare(const std::string& query) {
+    return entry->statements.get(*entry->conn, query);
+}
+
+void ConnectionLease::closeCursor() {
+    if (entry) entry->statements.closeCursor();
+}
+
+void ConnectionLease::release() {
+    if (pool && entry) {
+        // A result left pending would fail the next lease's checkout ping and retire the connection
+        if (!broken) entry->statements.closeCursor();
+        pool->release(std::move(entry), broken);
+    }
+    pool.reset();
+    broken = false;
+}
+
+// ============================================
+// ConnectionPool
+// ============================================
+ConnectionPool::ConnectionPool(const std::string& connStr, const PoolConfig& poolConfig)
+    : connectionString(connStr), config(poolConfig), opening(0), closed(false),
+      created(0), evicted(0), validationFailures(0), timeouts(0), checkouts(0), returns(0) {
+    if (config.maxSize == 0) config.maxSize = 1;
+    if (config.minSize > config.maxSize) config.minSize = config.maxSize;
+    
+    for (std::size_t i = 0; i < config.minSize; ++i) {
+        std::unique_ptr<PooledConnection> entry = open();
+        live.push_back(entry.get());
+        idle.push_back(std::move(entry));
+        ++created;
+    }
+}
+
+ConnectionPool::~ConnectionPool() {
+    close();
+}
+
+std::unique_ptr<PooledConnection> ConnectionPool::open() {
+    std::unique_ptr<PooledConnection> entry(new PooledConnection());
+    entry->conn = std::make_unique<nanodbc::connection>(connectionString);
+    entry->lastUsed = std::chrono::steady_clock::now();
+    return entry;
+}
+
+// Caller holds the mutex and closes the connection after unlocking
+void ConnectionPool::retire(const PooledConnection* entry) {
+    StatementCacheStats cache = entry->statements.stats();
+    retiredCacheStats.hits += cache.hits;
+    retiredCacheStats.misses += cache.misses;
+    live.erase(std::remove(live.begin(), live.end(), entry), live.end());
+}
+
+// Caller holds the mutex; returns idle connections past idleTimeout, oldest first
+std::vector<std::unique_ptr<PooledConnection>> ConnectionPool::takeExpired() {
+    std::vector<std::unique_ptr<PooledConnection>> expired;
+    if (config.idleTimeout.count() <= 0) return expired;
+    
+    auto cutoff = std::chrono::steady_clock::now() - config.idleTimeout;
+    while (!idle.empty() && live.size() - expired.size() > config.minSize &&
+           idle.front()->lastUsed < cutoff) {
+        expired.push_back(std::move(idle.front()));
+        idle.erase(idle.begin());
+        ++evicted;
+    }
+    return expired;
+}
+
+ConnectionLease ConnectionPool::acquire() {
+    auto deadline = std::chrono::steady_clock::now() + config.checkoutTimeout;
+    std::vector<std::unique_ptr<PooledConnection>> discarded;  // closed after the lock is released
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    while (!closed) {
+        for (auto& expired : takeExpired()) {
+            retire(expired.get());
+            discarded.push_back(std::move(expired));
+        }
+        
+        if (!idle.empty()) {
+            std::unique_ptr<PooledConnection> entry = std::move(idle.back());
+            idle.pop_back();
+            if (!config.validateOnCheckout) {
+                ++checkouts;
+                return ConnectionLease(shared_from_this(), std::move(entry));
+            }
+            
+            lock.unlock();
+            bool healthy = ping(*entry->conn);
+            lock.lock();
+            if (healthy) {
+                ++checkouts;
+                return ConnectionLease(shared_from_this(), std::move(entry));
+            }
+            
+            ++validationFailures;
+            retire(entry.get());
+            discarded.push_back(std::move(entry));
+            continue;
+        }
+        
+        if (live.size() + opening < config.maxSize) {
+            ++opening;
+            lock.unlock();
+            std::unique_ptr<PooledConnection> entry;
+            try {
+                entry = open();
+            } catch (...) {
+                lock.lock();
+                --opening;
+                available.notify_one();
+                throw;
+            }
+            lock.lock();
+            --opening;
+            ++created;
+            live.push_back(entry.get());
+            ++checkouts;
+            return ConnectionLease(shared_from_this(), std::move(entry));
+        }
+        
+        if (available.wait_until(lock, deadline) == std::cv_status::timeout &&
+            idle.empty() && live.size() + opening >= config.maxSize) {
+            ++timeouts;
+            return ConnectionLease();
+        }
+    }
+    
+    return ConnectionLease();
+}
+
+void ConnectionPool::release(std::unique_ptr<PooledConnection> entry, bool broken) {
+    entry->lastUsed = std::chrono::steady_clock::now();
+    std::unique_ptr<PooledConnection> discarded;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++returns;
+        if (closed || broken) {
+            retire(entry.get());
+            discarded = std::move(entry);
+        } else {
+            idle.push_back(std::move(entry));
+        }
+    }
+    available.notify_one();
+}
+
+void ConnectionPool::close() {
+    std::vector<std::unique_ptr<PooledConnection>> discarded;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        for (auto& entry : idle) {
+            retire(entry.get());
+        }
+        discarded.swap(idle);
+    }
+    available.notify_all();
+}
+
+void ConnectionPool::purgeIdle() {
+    std::vector<std::unique_ptr<PooledConnection>> discarded;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& entry : idle) {
+            retire(entry.get());
+        }
+        discarded.swap(idle);
+    }
+    available.notify_all();
+}
+
+bool ConnectionPool::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !closed;
+}
+
+PoolStats ConnectionPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    PoolStats result;
+    result.total = live.size();
+    result.idle = idle.size();
+    result.inUse = live.size() - idle.size();
+    result.created = created;
+    result.evicted = evicted;
+    result.validationFailures = validationFailures;
+    result.timeouts = timeouts;
+    result.checkouts = checkouts;
+    result.returns = returns;
+    return result;
+}
+
+StatementCacheStats ConnectionPool::statementCacheStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    StatementCacheStats result = retiredCacheStats;
+    for (PooledConnection* entry : live) {
+        StatementCacheStats cache = entry->statements.stats();
+        result.hits += cache.hits;
+        result.misses += cache.misses;
+        result.size += cache.size;
+    }
+    return result;
+}
+
+bool ConnectionPool::ping(nanodbc::connection& conn) {
+    try {
+        nanodbc::result result = nanodbc::execute(conn, "SELECT 1 AS TestConnection");
+        return result.next() && result.get<int>(0) == 1;
+    } catch (const nanodbc::database_error&) {
+        return false;
+    }
+}
@@ -0,0 +1,140 @@
+// FILE: ConnectionPool.h
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include <nanodbc/nanodbc.h>
+#include "StatementCache.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+
+struct PoolConfig {
+    std::size_t minSize;                        // connections kept open even when idle
+    std::size_t maxSize;                        // hard cap on open connections
+    std::chrono::milliseconds checkoutTimeout;  // how long acquire() waits for a free connection
+    std::chrono::milliseconds idleTimeout;      // idle connections above minSize are closed after this
+    bool validateOnCheckout;                    // run SELECT 1 before handing out an idle connection
+    
+    PoolConfig() : minSize(1), maxSize(4), checkoutTimeout(5000),
+                   idleTimeout(300000), validateOnCheckout(true) {}
+};
+
+struct PoolStats {
+    std::size_t total;
+    std::size_t idle;
+    std::size_t inUse;
+    std::size_t created;
+    std::size_t evicted;
+    std::size_t validationFailures;
+    std::size_t timeouts;
+    std::size_t checkouts;      // leases handed out
+    std::size_t returns;        // leases given back, including broken connections
+    
+    PoolStats() : total(0), idle(0), inUse(0), created(0), evicted(0),
+                  validationFailures(0), timeouts(0), checkouts(0), returns(0) {}
+};
+
+// One physical connection plus the statements prepared on it
+struct PooledConnection {
+    std::unique_ptr<nanodbc::connection> conn;
+    StatementCache statements;
+    std::chrono::steady_clock::time_point lastUsed;
+};
+
+class ConnectionPool;
+
+// Exclusive use of a pooled connection; returned to the pool on destruction.
+// A lease keeps its pool alive, so it may outlive DBManager::disconnect().
+class ConnectionLease {
+private:
+    std::shared_ptr<ConnectionPool> pool;
+    std::unique_ptr<PooledConnection> entry;
+    bool broken;
+
+public:
+    ConnectionLease() : broken(false) {}
+    ConnectionLease(std::shared_ptr<ConnectionPool> owner, std::unique_ptr<PooledConnection> pooled);
+    ConnectionLease(ConnectionLease&& other) noexcept;
+    ConnectionLease& operator=(ConnectionLease&& other) noexcept;
+    ConnectionLease(const ConnectionLease&) = delete;
+    ConnectionLease& operator=(const ConnectionLease&) = delete;
+    ~ConnectionLease();
+    
+    explicit operator bool() const { return entry != nullptr; }
+    
+    nanodbc::connection& connection();
+    
+    // Prepared statement for query on this connection, reused across leases
+    nanodbc::statement& prepare(const std::string& query);
+    
+    // Frees the connection for other statements (see StatementCache); release()
+    // does this before the connection goes back to the pool
+    void closeCursor();
+    
+    // Close the connection on release instead of returning it to the pool
+    void invalidate() { broken = true; }
+    
+    void release();
+};
+
+// Thread-safe; create with std::make_shared so leases can share ownership
+class ConnectionPool : public std::enable_shared_from_this<ConnectionPool> {
+private:
+    std::string connectionString;
+    PoolConfig config;
+    
+    mutable std::mutex mutex;
+    std::condition_variable available;
+    std::vector<std::unique_ptr<PooledConnection>> idle;  // most recently used at the back
+    std::vector<PooledConnection*> live;                  // every open connection, idle or leased
+    std::size_t opening;                                  // connections being opened outside the lock
+    bool closed;
+    
+    StatementCacheStats retiredCacheStats;
+    std::size_t created;
+    std::size_t evicted;
+    std::size_t validationFailures;
+    std::size_t timeouts;
+    std::size_t checkouts;
+    std::size_t returns;
+    
+    friend class ConnectionLease;
+    
+    std::unique_ptr<PooledConnection> open();
+    void release(std::unique_ptr<PooledConnection> entry, bool broken);
+    void retire(const PooledConnection* entry);
+    std::vector<std::unique_ptr<PooledConnection>> takeExpired();
+    
+public:
+    // Opens config.minSize connections up front; throws nanodbc::database_error on failure
+    ConnectionPool(const std::string& connStr, const PoolConfig& poolConfig);
+    ~ConnectionPool();
+    
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+    
+    // Waits up to checkoutTimeout for a connection; an empty lease means timeout
+    // or that the pool was closed meanwhile.
+    // Throws nanodbc::database_error if a new connection cannot be opened.
+    ConnectionLease acquire();
+    
+    // Closes idle connections; leased ones are closed as they come back
+    void close();
+    
+    // Drops every idle connection but keeps the pool open, e.g. after the
+    // network dropped and they all share the same dead link
+    void purgeIdle();
+    bool isOpen() const;
+    
+    PoolStats stats() const;
+    StatementCacheStats statementCacheStats() const;
+    
+    // Round trip used both for checkout validation and DBManager::testConnection
+    static bool ping(nanodbc::connection& conn);
+};
+
+#endif // CONNECTIONPOOL_H
@@ -0,0 +1,281 @@
+// FILE: DBCoroutines.h
+#ifndef DBCOROUTINES_H
+#define DBCOROUTINES_H
+
+// Awaitable front end for DBManager. Requires C++20 (-std=c++20 or /std:c++20);
+// under C++17 this header is empty and the rest of the project is unaffected.
+//
+//   Task<BorrowFlowResult> desk(AwaitableDB& db) {
+//       Member member = co_await db.getMemberById(7);
+//       ...
+//   }
+//   BorrowFlowResult r = syncWait(desk(db));
+//
+// A suspended coroutine holds no thread. Each co_await queues the blocking
+// call on DBManager's worker threads and resumes the coroutine there once the
+// call returns, so thousands of sessions interleave on PoolConfig::maxSize threads.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "DBManager.h"
+#include "Book.h"
+#include "Member.h"
+#include "Borrowing.h"
+#include "Reservation.h"
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+// Resumes whoever awaited the task once it finishes
+template <typename Promise>
+struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> done) noexcept {
+        std::coroutine_handle<> next = done.promise().continuation;
+        return next ? next : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+    FinalAwaiter<TaskPromise> final_suspend() const noexcept { return {}; }
+    void return_value(T result) { value.emplace(std::move(result)); }
+
+    T take() {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : PromiseBase {
+    Task<void> get_return_object() noexcept;
+    FinalAwaiter<TaskPromise> final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+
+    void take() {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+// Self-destroying coroutine used to start a Task without an awaiting parent
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+} // namespace detail
+
+// Lazily started coroutine; runs when awaited or passed to spawn()/syncWait()
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    T await_resume() { return handle.promise().take(); }
+
+private:
+    friend promise_type;
+    explicit Task(std::coroutine_handle<promise_type> h) noexcept : handle(h) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename T>
+Task<T> detail::TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+inline Task<void> detail::TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+namespace detail {
+
+template <typename T>
+Detached runDetached(Task<T> task, std::promise<T> done) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await task;
+            done.set_value();
+        } else {
+            done.set_value(co_await task);
+        }
+    } catch (...) {
+        done.set_exception(std::current_exception());
+    }
+}
+
+} // namespace detail
+
+// Starts task on the calling thread; it continues on DBManager's workers after its first co_await
+template <typename T>
+std::future<T> spawn(Task<T> task) {
+    std::promise<T> done;
+    std::future<T> result = done.get_future();
+    detail::runDetached(std::move(task), std::move(done));
+    return result;
+}
+
+// Blocks the calling thread until task finishes; never call from inside a coroutine
+template <typename T>
+T syncWait(Task<T> task) {
+    return spawn(std::move(task)).get();
+}
+
+// Suspends the awaiting coroutine while call runs on a DBManager worker thread
+template <typename T>
+class DBAwaitable {
+private:
+    DBManager& db;
+    std::function<T()> call;
+    std::optional<T> result;
+    std::exception_ptr error;
+
+public:
+    DBAwaitable(DBManager& manager, std::function<T()> work)
+        : db(manager), call(std::move(work)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        // The awaitable lives in the suspended frame, so `this` stays valid until resume
+        db.post([this, awaiting]() {
+            try {
+                result.emplace(call());
+            } catch (...) {
+                error = std::current_exception();
+            }
+            awaiting.resume();
+        });
+    }
+
+    T await_resume() {
+        if (error) std::rethrow_exception(error);
+        return std::move(*result);
+    }
+};
+
+enum class BorrowFlowResult {
+    Borrowed,
+    MemberNotFound,
+    MemberInactive,
+    BookNotFound,
+    NoCopiesAvailable,
+    Failed
+};
+
+// co_await-able mirror of the DBManager operations
+class AwaitableDB {
+private:
+    DBManager& db;
+
+public:
+    explicit AwaitableDB(DBManager& manager) : db(manager) {}
+
+    DBAwaitable<std::vector<Book>> getAllBooks() {
+        return {db, [this]() { return db.getAllBooks(); }};
+    }
+    DBAwaitable<std::vector<Book>> getAvailableBooks() {
+        return {db, [this]() { return db.getAvailableBooks(); }};
+    }
+    DBAwaitable<std::vector<Book>> searchBooksByTitle(std::string title) {
+        return {db, [this, title]() { return db.searchBooksByTitle(title); }};
+    }
+    DBAwaitable<Book> getBookById(int bookId) {
+        return {db, [this, bookId]() { return db.getBookById(bookId); }};
+    }
+    DBAwaitable<std::vector<Member>> getAllMembers() {
+        return {db, [this]() { return db.getAllMembers(); }};
+    }
+    DBAwaitable<Member> getMemberById(int memberId) {
+        return {db, [this, memberId]() { return db.getMemberById(memberId); }};
+    }
+    DBAwaitable<std::vector<Borrowing>> getCurrentBorrowings() {
+        return {db, [this]() { return db.getCurrentBorrowings(); }};
+    }
+    DBAwaitable<std::vector<Borrowing>> getMemberBorrowings(int memberId) {
+        return {db, [this, memberId]() { return db.getMemberBorrowings(memberId); }};
+    }
+    DBAwaitable<std::vector<Reservation>> getAllReservations() {
+        return {db, [this]() { return db.getAllReservations(); }};
+    }
+    DBAwaitable<bool> createBorrowing(int bookId, int memberId, int staffId, std::string dueDate) {
+        return {db, [this, bookId, memberId, staffId, dueDate]() {
+            return db.createBorrowing(bookId, memberId, staffId, dueDate);
+        }};
+    }
+    DBAwaitable<CheckoutResult> checkoutBook(int bookId, int memberId, int staffId, std::string dueDate) {
+        return {db, [this, bookId, memberId, staffId, dueDate]() {
+            return db.checkoutBook(bookId, memberId, staffId, dueDate);
+        }};
+    }
+    DBAwaitable<bool> returnBook(int borrowingId) {
+        return {db, [this, borrowingId]() { return db.returnBook(borrowingId); }};
+    }
+
+    // The desk borrow flow from main.cpp; CheckoutBook does every check server-side
+    Task<BorrowFlowResult> borrowBook(int bookId, int memberId, int staffId, std::string dueDate) {
+        CheckoutResult result = co_await checkoutBook(bookId, memberId, staffId, dueDate);
+        switch (result.status) {
+            case CheckoutStatus::CheckedOut: co_return BorrowFlowResult::Borrowed;
+            case CheckoutStatus::NoCopiesAvailable: co_return BorrowFlowResult::NoCopiesAvailable;
+            case CheckoutStatus::MemberNotActive: co_return BorrowFlowResult::MemberInactive;
+            case CheckoutStatus::MemberNotFound: co_return BorrowFlowResult::MemberNotFound;
+            case CheckoutStatus::BookNotFound: co_return BorrowFlowResult::BookNotFound;
+            case CheckoutStatus::Cancelled:   // batch-only, not produced by CheckoutBook
+            case CheckoutStatus::Failed: break;
+        }
+        co_return BorrowFlowResult::Failed;
+    }
+};
+
+#endif // coroutine support
+
+#endif // DBCOROUTINES_H
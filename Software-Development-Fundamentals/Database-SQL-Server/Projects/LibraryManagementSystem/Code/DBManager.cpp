@@ -1,5 +1,4 @@
 // FILE: DBManager.cpp
-#include <cstring>
 #include "DBManager.h"
 #include "Book.h"
 #include "Category.h"
@@ -7,62 +6,160 @@
 #include "Staff.h"
 #include "Borrowing.h"
 #include "Reservation.h"
-#include <sstream>
+#include "RowMapper.h"
 #include <iomanip>
-#include <ctime>
+#include <thread>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <stdexcept>
+#include <type_traits>
 
-DBManager::DBManager() {
-    logFile.open("library_db.log", std::ios::app);
-    if (!logFile.is_open()) {
+// Thrown by a runRead/runWrite body when the server answered without the
+// result it should have sent; the operation fails like a database error,
+// but is never retried
+struct OperationFailed : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// SQLSTATE class 08 covers lost and refused connections; HYT01 is a connection timeout
+static bool isConnectionError(const nanodbc::database_error& e) {
+    const std::string& state = e.state();
+    return state.compare(0, 2, "08") == 0 || state == "HYT01";
+}
+
+// Fallback for nullable text columns decoded by hand (the RowMapper handles its own)
+static const std::string NO_VALUE;
+
+// Statements are prepared, bound, executed and fetched through these so
+// OperationStats can count round trips and rows against the operation running
+// on this thread, and the slow-query log can see each statement's text, bound
+// values and prepare/execute/fetch times
+static nanodbc::statement& prepareStatement(ConnectionLease& lease, const std::string& query) {
+    StatementRecord* record = OperationTimer::beginStatement(query);
+    StatementPhase phase(record, &StatementRecord::prepareTime,
+                         &StatementRecord::prepareStarted);
+    return lease.prepare(query);
+}
+
+static nanodbc::result executeStatement(nanodbc::statement& stmt, long batchOperations = 1) {
+    OperationTimer::countRoundTrip();
+    StatementPhase phase(OperationTimer::currentStatement(), &StatementRecord::executeTime,
+                         &StatementRecord::executeStarted);
+    return nanodbc::execute(stmt, batchOperations);
+}
+
+static void justExecuteStatement(nanodbc::statement& stmt, long batchOperations = 1) {
+    OperationTimer::countRoundTrip();
+    StatementPhase phase(OperationTimer::currentStatement(), &StatementRecord::executeTime,
+                         &StatementRecord::executeStarted);
+    nanodbc::just_execute(stmt, batchOperations);
+}
+
+static bool fetchRow(nanodbc::result& result) {
+    StatementPhase phase(OperationTimer::currentStatement(), &StatementRecord::fetchTime,
+                         &StatementRecord::fetchStarted);
+    if (!result.next()) return false;
+    OperationTimer::countRows(1);
+    return true;
+}
+
+// Bound values are captured raw (no formatting, no allocation) and only
+// rendered if an observer reports the statement, e.g. as slow
+template <typename T>
+static void bindParameter(nanodbc::statement& stmt, short index, const T* value) {
+    static_assert(std::is_arithmetic<T>::value, "Scalar parameters must be numbers");
+    if (OperationTimer::capturingParameters()) {
+        if (std::is_floating_point<T>::value) OperationTimer::noteReal(index, static_cast<double>(*value));
+        else OperationTimer::noteInteger(index, static_cast<long long>(*value));
+    }
+    stmt.bind(index, value);
+}
+
+static void bindParameter(nanodbc::statement& stmt, short index, const char* value) {
+    if (OperationTimer::capturingParameters()) OperationTimer::noteText(index, value);
+    stmt.bind(index, value);
+}
+
+// Column arrays (one value per row of a bulk execute)
+template <typename T>
+static void bindParameter(nanodbc::statement& stmt, short index, const T* values, std::size_t count) {
+    if (OperationTimer::capturingParameters()) {
+        OperationTimer::noteShape(index, BoundParameter::Kind::Array, count);
+    }
+    stmt.bind(index, values, count);
+}
+
+static void bindStrings(nanodbc::statement& stmt, short index, const std::vector<std::string>& values) {
+    if (OperationTimer::capturingParameters()) {
+        OperationTimer::noteShape(index, BoundParameter::Kind::Array, values.size());
+    }
+    stmt.bind_strings(index, values);
+}
+
+// Personal data (email, phone): bound as usual but never written to a log
+static void bindMasked(nanodbc::statement& stmt, short index, const char* value) {
+    if (OperationTimer::capturingParameters()) OperationTimer::noteShape(index, BoundParameter::Kind::Masked);
+    stmt.bind(index, value);
+}
+
+static void noteTableParameter(short index, std::size_t rows) {
+    if (OperationTimer::capturingParameters()) {
+        OperationTimer::noteShape(index, BoundParameter::Kind::Table, rows);
+    }
+}
+
+DBManager::DBManager()
+    : defaultRowsetSize(128), writeRetries(0), writeGiveUps(0), logger("library_db.log"),
+      slowQueryLog("library_db_slow.log"), statementMetrics(metrics),
+      statementObservers({&slowQueryLog, &queryStats, &tracer, &statementMetrics}) {
+    if (!logger.isOpen()) {
         std::cerr << "Warning: Could not open log file." << std::endl;
     }
+    registerMetrics();
     log("DBManager initialized");
 }
 
 DBManager::~DBManager() {
+    metrics.stopExport();
+    // Queued async calls still use this object; let them finish first
+    workers.reset();
     disconnect();
-    if (logFile.is_open()) {
-        log("DBManager destroyed");
-        logFile.close();
-    }
+    // The logger drains its queue when it is destroyed after this
+    log("DBManager destroyed");
 }
 
-/*void DBManager::log(const std::string& message) {
-    if (logFile.is_open()) {
-        time_t now = time(nullptr);
-        char timeStr[26];
-        ctime_s(timeStr, sizeof(timeStr), &now);
-        timeStr[24] = '\0'; // Remove newline
-        logFile << "[" << timeStr << "] " << message << std::endl;
-    }
-}*/
 void DBManager::log(const std::string& message) {
-    if (logFile.is_open()) {
-        time_t now = time(nullptr);
-        char* timePtr = std::ctime(&now); 
-
-        
-        char timeStr[26]; 
-        
-        std::strncpy(timeStr, timePtr, 25); 
-        timeStr[25] = '\0'; 
-       
-        std::string timeString = timePtr;
-        timeString.pop_back(); 
-        logFile << "[" << timeString << "] " << message << std::endl;
-    }
+    if (logLevelEnabled(LogLevel::Info)) logger.write(LogLevel::Info, message);
 }
 
 void DBManager::logError(const std::string& error) {
-    log("ERROR: " + error);
+    logger.write(LogLevel::Error, error);
+    std::lock_guard<std::mutex> lock(consoleMutex);
     std::cerr << "ERROR: " << error << std::endl;
 }
 
 bool DBManager::connect(const std::string& connStr) {
+    PoolConfig config;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        config = poolConfig;
+    }
+    
     try {
-        connectionString = connStr;
-        conn = std::make_unique<nanodbc::connection>(connStr);
-        log("Connected to database successfully");
+        // Open the new pool before swapping so callers never see a half-built one
+        auto newPool = std::make_shared<ConnectionPool>(connStr, config);
+        std::shared_ptr<ConnectionPool> oldPool;
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            connectionString = connStr;
+            oldPool = std::move(pool);
+            pool = std::move(newPool);
+        }
+        if (oldPool) oldPool->close();
+        
+        log("Connected to database successfully (pool " + std::to_string(config.minSize) +
+            "-" + std::to_string(config.maxSize) + " connections)");
         return true;
     } catch (const nanodbc::database_error& e) {
         logError(std::string("Connection failed: ") + e.what());
@@ -71,86 +168,346 @@ bool DBManager::connect(const std::string& connStr) {
 }
 
 bool DBManager::disconnect() {
-    if (conn && conn->connected()) {
-        try {
-            conn->disconnect();
-            log("Disconnected from database");
-            return true;
-        } catch (const nanodbc::database_error& e) {
-            logError(std::string("Disconnect failed: ") + e.what());
-            return false;
-        }
+    std::shared_ptr<ConnectionPool> oldPool;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        oldPool = std::move(pool);
+    }
+    
+    if (oldPool) {
+        // Idle connections close now; leased ones close when their operation ends
+        oldPool->close();
+        log("Disconnected from database");
     }
     return true;
 }
 
+std::shared_ptr<ConnectionPool> DBManager::currentPool() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return pool;
+}
+
 bool DBManager::isConnected() const {
-    return conn && conn->connected();
+    std::shared_ptr<ConnectionPool> current = currentPool();
+    return current && current->isOpen();
 }
 
-bool DBManager::testConnection() {
-    if (!isConnected()) {
+ConnectionLease DBManager::acquireConnection() {
+    std::shared_ptr<ConnectionPool> current = currentPool();
+    if (!current || !current->isOpen()) {
         logError("Not connected to database");
+        return ConnectionLease();
+    }
+    
+    try {
+        ConnectionLease lease = current->acquire();
+        if (!lease) {
+            // Either the checkout timed out or disconnect() closed the pool while we waited
+            logError(current->isOpen() ? "Timed out waiting for a pooled connection"
+                                       : "Not connected to database");
+        }
+        return lease;
+    } catch (const nanodbc::database_error& e) {
+        logError(std::string("Open pooled connection failed: ") + e.what());
+        return ConnectionLease();
+    }
+}
+
+bool DBManager::testConnection() {
+    ConnectionLease lease = acquireConnection();
+    if (!lease) return false;
+    
+    if (ConnectionPool::ping(lease.connection())) {
+        log("Connection test successful");
+        return true;
+    }
+    
+    lease.invalidate();
+    logError("Connection test failed");
+    return false;
+}
+
+WorkQueue& DBManager::workQueue() {
+    std::lock_guard<std::mutex> lock(workersMutex);
+    if (!workers) {
+        // One worker per pooled connection; more would only wait on checkout
+        std::size_t threads;
+        {
+            std::lock_guard<std::mutex> poolLock(poolMutex);
+            threads = poolConfig.maxSize;
+        }
+        workers = std::make_unique<WorkQueue>(threads);
+    }
+    return *workers;
+}
+
+bool DBManager::runInScope(TransactionScope& scope, const std::string& operation,
+                           const std::function<void(ConnectionLease&)>& body, bool isWrite) {
+    if (!scope.active()) {
+        logError(operation + " failed: transaction scope has no connection");
+        return false;
+    }
+    
+    // No reconnect or deadlock retry here: either would lose the rest of the transaction.
+    // The scope's later operations and savepoints share this connection, so the
+    // cursor is closed before returning either way.
+    try {
+        body(scope.lease());
+        scope.lease().closeCursor();
+        return true;
+    } catch (const nanodbc::database_error& e) {
+        scope.lease().closeCursor();
+        if (isWrite) scope.markFailed();
+        logError(operation + " failed: " + e.what());
+        return false;
+    } catch (const OperationFailed& e) {
+        scope.lease().closeCursor();
+        if (isWrite) scope.markFailed();
+        logError(operation + " failed: " + e.what());
         return false;
     }
+}
+
+bool DBManager::runRead(const std::string& operation,
+                        const std::function<void(ConnectionLease&)>& body, bool rerunnable) {
+    OperationTimer timer(operationStats, operation, &statementObservers);
+    if (TransactionScope* scope = TransactionScope::current(this)) {
+        bool done = runInScope(*scope, operation, body, false);
+        if (done) timer.succeeded();
+        return done;
+    }
+    
+    int retries;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        retries = rerunnable ? reconnectPolicy.readRetries : 0;
+    }
     
+    for (int attempt = 0; ; ++attempt) {
+        std::shared_ptr<ConnectionPool> current = currentPool();
+        if (!current || !current->isOpen()) {
+            logError("Not connected to database");
+            return false;
+        }
+        
+        ConnectionLease lease;
+        try {
+            // Idle connections are pinged on checkout, so after a network drop the
+            // pool falls through to opening a new one and that open is what throws
+            lease = current->acquire();
+            if (!lease) {
+                logError(current->isOpen() ? "Timed out waiting for a pooled connection"
+                                           : "Not connected to database");
+                return false;
+            }
+            body(lease);
+            timer.succeeded();
+            return true;
+        } catch (const nanodbc::database_error& e) {
+            bool lost = !lease || isConnectionError(e);
+            if (!lost || attempt >= retries) {
+                logError(operation + " failed: " + e.what());
+                return false;
+            }
+            if (lease) {
+                lease.invalidate();
+                lease.release();
+            }
+            log(operation + " lost its connection, reconnecting: " + e.what());
+            if (!reconnect()) {
+                logError(operation + " failed: " + e.what());
+                return false;
+            }
+        } catch (const OperationFailed& e) {
+            logError(operation + " failed: " + e.what());
+            return false;
+        }
+    }
+}
+
+bool DBManager::isRetryableWriteError(const nanodbc::database_error& e) const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    const WriteRetryPolicy& policy = writeRetryPolicy;
+    return std::find(policy.retryableNativeCodes.begin(), policy.retryableNativeCodes.end(),
+                     static_cast<int>(e.native())) != policy.retryableNativeCodes.end() ||
+           std::find(policy.retryableStates.begin(), policy.retryableStates.end(),
+                     e.state()) != policy.retryableStates.end();
+}
+
+// Before a lease goes back to the pool after a failed write. The failed
+// statement may still have rows pending, and without MARS the rollback would
+// then fail and cost the connection, so its cursor is closed first.
+static void rollbackOpenTransaction(ConnectionLease& lease) {
+    lease.closeCursor();
     try {
-        nanodbc::result result = nanodbc::execute(*conn, "SELECT 1 AS TestConnection");
-        if (result.next()) {
-            int value = result.get<int>(0);
-            if (value == 1) {
-                log("Connection test successful");
+        nanodbc::execute(lease.connection(), "IF @@TRANCOUNT > 0 ROLLBACK TRANSACTION");
+    } catch (const nanodbc::database_error&) {
+        lease.invalidate();
+    }
+}
+
+bool DBManager::runWrite(const std::string& operation,
+                         const std::function<void(ConnectionLease&)>& body) {
+    OperationTimer timer(operationStats, operation, &statementObservers);
+    if (TransactionScope* scope = TransactionScope::current(this)) {
+        bool done = runInScope(*scope, operation, body, true);
+        if (done) timer.succeeded();
+        return done;
+    }
+    
+    BackoffPolicy backoff;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        backoff = writeRetryPolicy.backoff;
+    }
+    
+    for (int attempt = 1; ; ++attempt) {
+        {
+            ConnectionLease lease = acquireConnection();
+            if (!lease) return false;
+            
+            try {
+                body(lease);
+                timer.succeeded();
                 return true;
+            } catch (const nanodbc::database_error& e) {
+                // A deadlock victim is already rolled back, a lock timeout is not;
+                // either way no open transaction may go back to the pool
+                rollbackOpenTransaction(lease);
+                
+                if (!isRetryableWriteError(e)) {
+                    logError(operation + " failed: " + e.what());
+                    return false;
+                }
+                if (attempt >= backoff.maxAttempts) {
+                    ++writeGiveUps;
+                    logError(operation + " failed after " + std::to_string(attempt) +
+                             " attempts: " + e.what());
+                    return false;
+                }
+                ++writeRetries;
+                log(operation + " hit a lock conflict, retrying: " + e.what());
+            } catch (const OperationFailed& e) {
+                rollbackOpenTransaction(lease);
+                logError(operation + " failed: " + e.what());
+                return false;
             }
         }
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Connection test failed: ") + e.what());
+        // Lease is back in the pool while we wait
+        std::this_thread::sleep_for(backoffDelay(backoff, attempt));
+    }
+}
+
+bool DBManager::reconnect() {
+    std::lock_guard<std::mutex> guard(reconnectMutex);
+    
+    std::shared_ptr<ConnectionPool> current = currentPool();
+    if (!current || !current->isOpen()) return false;
+    BackoffPolicy backoff;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        backoff = reconnectPolicy.backoff;
+    }
+    
+    // Idle connections share the link that just failed; do not ping them one by one
+    current->purgeIdle();
+    
+    for (int attempt = 1; attempt <= backoff.maxAttempts; ++attempt) {
+        if (attempt > 1) {
+            std::this_thread::sleep_for(backoffDelay(backoff, attempt - 1));
+        }
+        try {
+            ConnectionLease lease = current->acquire();
+            if (lease && ConnectionPool::ping(lease.connection())) {
+                log("Reconnected to database after " + std::to_string(attempt) + " attempt(s)");
+                return true;
+            }
+            if (lease) lease.invalidate();
+            if (!current->isOpen()) return false;   // disconnect() while we were retrying
+        } catch (const nanodbc::database_error& e) {
+            log("Reconnect attempt " + std::to_string(attempt) + " failed: " + e.what());
+        }
     }
+    
+    logError("Could not reconnect after " + std::to_string(backoff.maxAttempts) + " attempts");
     return false;
 }
 
+void DBManager::setReconnectPolicy(const ReconnectPolicy& policy) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    reconnectPolicy = policy;
+}
+
+void DBManager::setWriteRetryPolicy(const WriteRetryPolicy& policy) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    writeRetryPolicy = policy;
+}
+
+WriteRetryStats DBManager::getWriteRetryStats() const {
+    WriteRetryStats stats;
+    stats.retries = writeRetries.load();
+    stats.giveUps = writeGiveUps.load();
+    return stats;
+}
+
+long DBManager::rowsetSize(const std::string& operation) const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    std::unordered_map<std::string, long>::const_iterator it = rowsetSizes.find(operation);
+    return it != rowsetSizes.end() ? it->second : defaultRowsetSize;
+}
+
+void DBManager::setRowsetSize(long rows) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    defaultRowsetSize = std::max(1L, rows);
+}
+
+void DBManager::setRowsetSize(const std::string& operation, long rows) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    rowsetSizes[operation] = std::max(1L, rows);
+}
+
+void DBManager::setPoolConfig(const PoolConfig& config) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    poolConfig = config;
+}
+
+PoolStats DBManager::getPoolStats() const {
+    std::shared_ptr<ConnectionPool> current = currentPool();
+    return current ? current->stats() : PoolStats();
+}
+
 // ============================================
 // Category Operations
 // ============================================
 bool DBManager::createCategory(const std::string& name, const std::string& description) {
-    if (!isConnected()) return false;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "INSERT INTO Categories (CategoryName, Description) VALUES (?, ?)");
+    return runWrite("Create category", [&](ConnectionLease& lease) {
+        nanodbc::statement& stmt = prepareStatement(lease, "INSERT INTO Categories (CategoryName, Description) VALUES (?, ?)");
         
-        stmt.bind(0, name.c_str());
-        stmt.bind(1, description.c_str());
+        bindParameter(stmt, 0, name.c_str());
+        bindParameter(stmt, 1, description.c_str());
         
-        nanodbc::execute(stmt);
+        executeStatement(stmt);
         log("Category created: " + name);
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Create category failed: ") + e.what());
-        return false;
-    }
+    });
 }
 
 std::vector<Category> DBManager::getAllCategories() {
     std::vector<Category> categories;
-    if (!isConnected()) return categories;
-    
-    try {
-        nanodbc::result result = nanodbc::execute(*conn, 
+    runRead("Get categories", [&](ConnectionLease& lease) {
+        categories.clear();
+        nanodbc::statement& stmt = prepareStatement(lease, 
             "SELECT CategoryID, CategoryName, Description FROM Categories ORDER BY CategoryName");
+        nanodbc::result result = executeStatement(stmt, rowsetSize("Get categories"));
         
-        while (result.next()) {
-            Category cat;
-            cat.categoryId = result.get<int>(0);
-            cat.categoryName = result.get<std::string>(1);
-            cat.description = result.get<std::string>(2, "");
-            categories.push_back(cat);
+        while (fetchRow(result)) {
+            Category& cat = categories.emplace_back();
+            result.get_ref(0, cat.categoryId);
+            result.get_ref(1, cat.categoryName);
+            result.get_ref(2, NO_VALUE, cat.description);
         }
         
-        log("Retrieved " + std::to_string(categories.size()) + " categories");
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get categories failed: ") + e.what());
-    }
+        logDebug([&]() { return "Retrieved " + std::to_string(categories.size()) + " categories"; });
+    });
     
     return categories;
 }
@@ -158,223 +515,327 @@ std::vector<Category> DBManager::getAllCategories() {
 // ============================================
 // Book Operations
 // ============================================
+static const char* const INSERT_BOOK_SQL =
+    "INSERT INTO Books (ISBN, Title, Author, Publisher, PublicationYear, "
+    "CategoryID, TotalCopies, AvailableCopies, Price, ShelfLocation) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
 bool DBManager::createBook(const std::string& isbn, const std::string& title,
                            const std::string& author, const std::string& publisher,
                            int year, int categoryId, int totalCopies,
                            double price, const std::string& shelfLocation) {
-    if (!isConnected()) return false;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "INSERT INTO Books (ISBN, Title, Author, Publisher, PublicationYear, "
-                     "CategoryID, TotalCopies, AvailableCopies, Price, ShelfLocation) "
-                     "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
-        
-        stmt.bind(0, isbn.c_str());
-        stmt.bind(1, title.c_str());
-        stmt.bind(2, author.c_str());
-        stmt.bind(3, publisher.c_str());
-        stmt.bind(4, &year);
-        stmt.bind(5, &categoryId);
-        stmt.bind(6, &totalCopies);
-        stmt.bind(7, &totalCopies); // AvailableCopies initially equals TotalCopies
-        stmt.bind(8, &price);
-        stmt.bind(9, shelfLocation.c_str());
-        
-        nanodbc::execute(stmt);
+    return runWrite("Create book", [&](ConnectionLease& lease) {
+        nanodbc::statement& stmt = prepareStatement(lease, INSERT_BOOK_SQL);
+        
+        bindParameter(stmt, 0, isbn.c_str());
+        bindParameter(stmt, 1, title.c_str());
+        bindParameter(stmt, 2, author.c_str());
+        bindParameter(stmt, 3, publisher.c_str());
+        bindParameter(stmt, 4, &year);
+        bindParameter(stmt, 5, &categoryId);
+        bindParameter(stmt, 6, &totalCopies);
+        bindParameter(stmt, 7, &totalCopies); // AvailableCopies initially equals TotalCopies
+        bindParameter(stmt, 8, &price);
+        bindParameter(stmt, 9, shelfLocation.c_str());
+        
+        executeStatement(stmt);
         log("Book created: " + title + " (ISBN: " + isbn + ")");
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Create book failed: ") + e.what());
-        return false;
+    });
+}
+
+BulkInsertResult DBManager::createBooksBulk(const std::vector<Book>& books,
+                                            std::size_t chunkSize) {
+    BulkInsertResult outcome;
+    if (books.empty()) {
+        outcome.committed = true;
+        return outcome;
+    }
+    if (chunkSize == 0) chunkSize = 1;
+    
+    // A deadlock anywhere rolls back the whole transaction, so the import reruns from row 0
+    bool done = runWrite("Bulk import", [&](ConnectionLease& lease) {
+        outcome = BulkInsertResult();
+        nanodbc::connection& conn = lease.connection();
+        // Joins a caller's TransactionScope if there is one
+        nanodbc::transaction transaction(conn);
+        
+        for (std::size_t start = 0; start < books.size(); start += chunkSize) {
+            std::size_t count = std::min(chunkSize, books.size() - start);
+            
+            // Column arrays for this chunk; they must outlive the execute below
+            std::vector<std::string> isbns, titles, authors, publishers, shelves;
+            std::vector<int> years, categories, copies;
+            std::vector<double> prices;
+            isbns.reserve(count); titles.reserve(count); authors.reserve(count);
+            publishers.reserve(count); shelves.reserve(count);
+            years.reserve(count); categories.reserve(count); copies.reserve(count);
+            prices.reserve(count);
+            
+            for (std::size_t i = start; i < start + count; ++i) {
+                const Book& book = books[i];
+                isbns.push_back(book.isbn);
+                titles.push_back(book.title);
+                authors.push_back(book.author);
+                publishers.push_back(book.publisher);
+                years.push_back(book.publicationYear);
+                categories.push_back(book.categoryId);
+                copies.push_back(book.totalCopies);
+                prices.push_back(book.price);
+                shelves.push_back(book.shelfLocation);
+            }
+            
+            bool chunkSaved = saveTransaction(conn, "BulkChunk");
+            try {
+                nanodbc::statement& stmt = prepareStatement(lease, INSERT_BOOK_SQL);
+                bindStrings(stmt, 0, isbns);
+                bindStrings(stmt, 1, titles);
+                bindStrings(stmt, 2, authors);
+                bindStrings(stmt, 3, publishers);
+                bindParameter(stmt, 4, years.data(), count);
+                bindParameter(stmt, 5, categories.data(), count);
+                bindParameter(stmt, 6, copies.data(), count);
+                bindParameter(stmt, 7, copies.data(), count); // AvailableCopies initially equals TotalCopies
+                bindParameter(stmt, 8, prices.data(), count);
+                bindStrings(stmt, 9, shelves);
+                
+                justExecuteStatement(stmt, static_cast<long>(count));
+                outcome.inserted += count;
+                continue;
+            } catch (const nanodbc::database_error& e) {
+                // A deadlock took the savepoint with it; let runWrite restart the import
+                if (isRetryableWriteError(e)) throw;
+                // Rows before the bad one may already be in; undo the chunk and replay it singly
+                rollbackTransactionTo(conn, "BulkChunk", chunkSaved);
+                log("Bulk import chunk at row " + std::to_string(start) +
+                    " failed, retrying row by row: " + e.what());
+            }
+            
+            for (std::size_t i = start; i < start + count; ++i) {
+                const Book& book = books[i];
+                bool rowSaved = saveTransaction(conn, "BulkRow");
+                try {
+                    nanodbc::statement& stmt = prepareStatement(lease, INSERT_BOOK_SQL);
+                    bindParameter(stmt, 0, book.isbn.c_str());
+                    bindParameter(stmt, 1, book.title.c_str());
+                    bindParameter(stmt, 2, book.author.c_str());
+                    bindParameter(stmt, 3, book.publisher.c_str());
+                    bindParameter(stmt, 4, &book.publicationYear);
+                    bindParameter(stmt, 5, &book.categoryId);
+                    bindParameter(stmt, 6, &book.totalCopies);
+                    bindParameter(stmt, 7, &book.totalCopies);
+                    bindParameter(stmt, 8, &book.price);
+                    bindParameter(stmt, 9, book.shelfLocation.c_str());
+                    
+                    justExecuteStatement(stmt);
+                    ++outcome.inserted;
+                } catch (const nanodbc::database_error& e) {
+                    if (isRetryableWriteError(e)) throw;
+                    rollbackTransactionTo(conn, "BulkRow", rowSaved);
+                    outcome.failures.push_back(BulkRowError(i, e.what()));
+                }
+            }
+        }
+        
+        transaction.commit();
+        outcome.committed = true;
+        log("Bulk import: " + std::to_string(outcome.inserted) + " of " +
+            std::to_string(books.size()) + " books inserted, " +
+            std::to_string(outcome.failures.size()) + " rejected");
+    });
+    
+    if (!done) {
+        // Only reached when the transaction itself is unusable (e.g. doomed or link lost)
+        outcome.committed = false;
+        outcome.inserted = 0;
     }
+    return outcome;
 }
 
 std::vector<Book> DBManager::getAllBooks() {
     std::vector<Book> books;
-    if (!isConnected()) return books;
-    
-    try {
-        nanodbc::result result = nanodbc::execute(*conn,
-            "SELECT b.BookID, b.ISBN, b.Title, b.Author, b.Publisher, b.PublicationYear, "
-            "b.CategoryID, c.CategoryName, b.TotalCopies, b.AvailableCopies, b.Price, b.ShelfLocation "
+    runRead("Get all books", [&](ConnectionLease& lease) {
+        books.clear();
+        static const std::string query =
+            "SELECT " + BookMapper::selectList() + " "
             "FROM Books b "
             "INNER JOIN Categories c ON b.CategoryID = c.CategoryID "
-            "ORDER BY b.Title");
-        
-        while (result.next()) {
-            Book book;
-            book.bookId = result.get<int>(0);
-            book.isbn = result.get<std::string>(1);
-            book.title = result.get<std::string>(2);
-            book.author = result.get<std::string>(3);
-            book.publisher = result.get<std::string>(4, "");
-            book.publicationYear = result.get<int>(5);
-            book.categoryId = result.get<int>(6);
-            book.categoryName = result.get<std::string>(7);
-            book.totalCopies = result.get<int>(8);
-            book.availableCopies = result.get<int>(9);
-            book.price = result.get<double>(10);
-            book.shelfLocation = result.get<std::string>(11, "");
-            books.push_back(book);
-        }
-        
-        log("Retrieved " + std::to_string(books.size()) + " books");
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get all books failed: ") + e.what());
-    }
+            "ORDER BY b.Title";
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        nanodbc::result result = executeStatement(stmt, rowsetSize("Get all books"));
+        
+        while (fetchRow(result)) {
+            Book& book = books.emplace_back();
+            BookMapper::decode(result, book);
+        }
+        
+        logDebug([&]() { return "Retrieved " + std::to_string(books.size()) + " books"; });
+    });
     
     return books;
 }
 
+Page<Book, BookCursor> DBManager::getBooksPage(const BookCursor& after, int limit) {
+    Page<Book, BookCursor> page;
+    if (limit <= 0) return page;
+    
+    runRead("Get books page", [&](ConnectionLease& lease) {
+        page = Page<Book, BookCursor>();
+        // One extra row tells us whether another page exists without a COUNT(*)
+        int fetch = limit + 1;
+        std::string query =
+            "SELECT TOP (?) " + BookMapper::selectList() + " "
+            "FROM Books b "
+            "INNER JOIN Categories c ON b.CategoryID = c.CategoryID ";
+        if (!after.atStart()) {
+            query += "WHERE b.Title > ? OR (b.Title = ? AND b.BookID > ?) ";
+        }
+        query += "ORDER BY b.Title, b.BookID";
+        
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        bindParameter(stmt, 0, &fetch);
+        if (!after.atStart()) {
+            bindParameter(stmt, 1, after.title.c_str());
+            bindParameter(stmt, 2, after.title.c_str());
+            bindParameter(stmt, 3, &after.bookId);
+        }
+        nanodbc::result result = executeStatement(stmt);
+        
+        while (fetchRow(result)) {
+            if (static_cast<int>(page.items.size()) == limit) {
+                page.hasMore = true;
+                break;
+            }
+            BookMapper::decode(result, page.items.emplace_back());
+        }
+        
+        if (!page.items.empty()) {
+            page.next = BookCursor(page.items.back().title, page.items.back().bookId);
+        }
+    });
+    
+    return page;
+}
+
+bool DBManager::forEachBook(const std::function<void(const Book&)>& visit) {
+    // Timed including visit, which runs while the rows stream in
+    return runRead("For each book", [&](ConnectionLease& lease) {
+        static const std::string query =
+            "SELECT " + BookMapper::selectList() + " "
+            "FROM Books b "
+            "INNER JOIN Categories c ON b.CategoryID = c.CategoryID "
+            "ORDER BY b.Title";
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        nanodbc::result result = executeStatement(stmt, rowsetSize("For each book"));
+        
+        // One Book is refilled per row, so memory stays flat however large the table
+        Book book;
+        long rows = 0;
+        while (fetchRow(result)) {
+            BookMapper::decode(result, book);
+            visit(book);
+            ++rows;
+        }
+        
+        logDebug([&]() { return "Streamed " + std::to_string(rows) + " books"; });
+    }, false);
+}
+
 std::vector<Book> DBManager::getAvailableBooks() {
     std::vector<Book> books;
-    if (!isConnected()) return books;
-    
-    try {
-        nanodbc::result result = nanodbc::execute(*conn,
-            "SELECT BookID, ISBN, Title, Author, Publisher, PublicationYear, "
-            "CategoryName, AvailableCopies, TotalCopies, Price, ShelfLocation "
-            "FROM AvailableBooks ORDER BY Title");
-        
-        while (result.next()) {
-            Book book;
-            book.bookId = result.get<int>(0);
-            book.isbn = result.get<std::string>(1);
-            book.title = result.get<std::string>(2);
-            book.author = result.get<std::string>(3);
-            book.publisher = result.get<std::string>(4, "");
-            book.publicationYear = result.get<int>(5);
-            book.categoryName = result.get<std::string>(6);
-            book.availableCopies = result.get<int>(7);
-            book.totalCopies = result.get<int>(8);
-            book.price = result.get<double>(9);
-            book.shelfLocation = result.get<std::string>(10, "");
-            books.push_back(book);
-        }
-        
-        log("Retrieved " + std::to_string(books.size()) + " available books");
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get available books failed: ") + e.what());
-    }
+    runRead("Get available books", [&](ConnectionLease& lease) {
+        books.clear();
+        // Same filter as the AvailableBooks view, but on the base tables so the
+        // shared Book column list (including CategoryID) applies
+        static const std::string query =
+            "SELECT " + BookMapper::selectList() + " "
+            "FROM Books b "
+            "INNER JOIN Categories c ON b.CategoryID = c.CategoryID "
+            "WHERE b.AvailableCopies > 0 ORDER BY b.Title";
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        nanodbc::result result = executeStatement(stmt, rowsetSize("Get available books"));
+        
+        while (fetchRow(result)) {
+            Book& book = books.emplace_back();
+            BookMapper::decode(result, book);
+        }
+        
+        logDebug([&]() { return "Retrieved " + std::to_string(books.size()) + " available books"; });
+    });
     
     return books;
 }
 
 std::vector<Book> DBManager::searchBooksByTitle(const std::string& title) {
     std::vector<Book> books;
-    if (!isConnected()) return books;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "SELECT b.BookID, b.ISBN, b.Title, b.Author, b.Publisher, b.PublicationYear, "
-                     "b.CategoryID, c.CategoryName, b.TotalCopies, b.AvailableCopies, b.Price, b.ShelfLocation "
-                     "FROM Books b "
-                     "INNER JOIN Categories c ON b.CategoryID = c.CategoryID "
-                     "WHERE b.Title LIKE ? ORDER BY b.Title");
+    runRead("Search books", [&](ConnectionLease& lease) {
+        books.clear();
+        static const std::string query =
+            "SELECT " + BookMapper::selectList() + " "
+            "FROM Books b "
+            "INNER JOIN Categories c ON b.CategoryID = c.CategoryID "
+            "WHERE b.Title LIKE ? ORDER BY b.Title";
+        nanodbc::statement& stmt = prepareStatement(lease, query);
         
         std::string searchPattern = "%" + title + "%";
-        stmt.bind(0, searchPattern.c_str());
-        
-        nanodbc::result result = nanodbc::execute(stmt);
-        
-        while (result.next()) {
-            Book book;
-            book.bookId = result.get<int>(0);
-            book.isbn = result.get<std::string>(1);
-            book.title = result.get<std::string>(2);
-            book.author = result.get<std::string>(3);
-            book.publisher = result.get<std::string>(4, "");
-            book.publicationYear = result.get<int>(5);
-            book.categoryId = result.get<int>(6);
-            book.categoryName = result.get<std::string>(7);
-            book.totalCopies = result.get<int>(8);
-            book.availableCopies = result.get<int>(9);
-            book.price = result.get<double>(10);
-            book.shelfLocation = result.get<std::string>(11, "");
-            books.push_back(book);
-        }
-        
-        log("Search found " + std::to_string(books.size()) + " books for: " + title);
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Search books failed: ") + e.what());
-    }
+        bindParameter(stmt, 0, searchPattern.c_str());
+        
+        nanodbc::result result = executeStatement(stmt);
+        
+        while (fetchRow(result)) {
+            Book& book = books.emplace_back();
+            BookMapper::decode(result, book);
+        }
+        
+        logDebug([&]() { return "Search found " + std::to_string(books.size()) + " books for: " + title; });
+    });
     
     return books;
 }
 
 Book DBManager::getBookById(int bookId) {
     Book book;
-    if (!isConnected()) return book;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "SELECT b.BookID, b.ISBN, b.Title, b.Author, b.Publisher, b.PublicationYear, "
-                     "b.CategoryID, c.CategoryName, b.TotalCopies, b.AvailableCopies, b.Price, b.ShelfLocation "
-                     "FROM Books b "
-                     "INNER JOIN Categories c ON b.CategoryID = c.CategoryID "
-                     "WHERE b.BookID = ?");
-        
-        stmt.bind(0, &bookId);
-        nanodbc::result result = nanodbc::execute(stmt);
-        
-        if (result.next()) {
-            book.bookId = result.get<int>(0);
-            book.isbn = result.get<std::string>(1);
-            book.title = result.get<std::string>(2);
-            book.author = result.get<std::string>(3);
-            book.publisher = result.get<std::string>(4, "");
-            book.publicationYear = result.get<int>(5);
-            book.categoryId = result.get<int>(6);
-            book.categoryName = result.get<std::string>(7);
-            book.totalCopies = result.get<int>(8);
-            book.availableCopies = result.get<int>(9);
-            book.price = result.get<double>(10);
-            book.shelfLocation = result.get<std::string>(11, "");
+    runRead("Get book by ID", [&](ConnectionLease& lease) {
+        book = Book();
+        static const std::string query =
+            "SELECT " + BookMapper::selectList() + " "
+            "FROM Books b "
+            "INNER JOIN Categories c ON b.CategoryID = c.CategoryID "
+            "WHERE b.BookID = ?";
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        
+        bindParameter(stmt, 0, &bookId);
+        nanodbc::result result = executeStatement(stmt);
+        
+        if (fetchRow(result)) {
+            BookMapper::decode(result, book);
         }
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get book by ID failed: ") + e.what());
-    }
+    });
     
     return book;
 }
 
 bool DBManager::updateBookAvailability(int bookId, int availableCopies) {
-    if (!isConnected()) return false;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "UPDATE Books SET AvailableCopies = ?, UpdatedAt = GETDATE() WHERE BookID = ?");
+    return runWrite("Update book availability", [&](ConnectionLease& lease) {
+        nanodbc::statement& stmt = prepareStatement(lease, "UPDATE Books SET AvailableCopies = ?, UpdatedAt = GETDATE() WHERE BookID = ?");
         
-        stmt.bind(0, &availableCopies);
-        stmt.bind(1, &bookId);
+        bindParameter(stmt, 0, &availableCopies);
+        bindParameter(stmt, 1, &bookId);
         
-        nanodbc::execute(stmt);
+        executeStatement(stmt);
         log("Book availability updated: BookID " + std::to_string(bookId) + 
             ", Available: " + std::to_string(availableCopies));
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Update book availability failed: ") + e.what());
-        return false;
-    }
+    });
 }
 
 bool DBManager::deleteBook(int bookId) {
-    if (!isConnected()) return false;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "DELETE FROM Books WHERE BookID = ?");
+    return runWrite("Delete book", [&](ConnectionLease& lease) {
+        nanodbc::statement& stmt = prepareStatement(lease, "DELETE FROM Books WHERE BookID = ?");
         
-        stmt.bind(0, &bookId);
-        nanodbc::execute(stmt);
+        bindParameter(stmt, 0, &bookId);
+        executeStatement(stmt);
         
         log("Book deleted: BookID " + std::to_string(bookId));
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Delete book failed: ") + e.what());
-        return false;
-    }
+    });
 }
 
 // ============================================
@@ -383,106 +844,121 @@ bool DBManager::deleteBook(int bookId) {
 bool DBManager::createMember(const std::string& firstName, const std::string& lastName,
                              const std::string& email, const std::string& phone,
                              const std::string& address) {
-    if (!isConnected()) return false;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "INSERT INTO Members (FirstName, LastName, Email, Phone, Address) "
-                     "VALUES (?, ?, ?, ?, ?)");
+    return runWrite("Create member", [&](ConnectionLease& lease) {
+        nanodbc::statement& stmt = prepareStatement(lease, 
+            "INSERT INTO Members (FirstName, LastName, Email, Phone, Address) "
+            "VALUES (?, ?, ?, ?, ?)");
         
-        stmt.bind(0, firstName.c_str());
-        stmt.bind(1, lastName.c_str());
-        stmt.bind(2, email.c_str());
-        stmt.bind(3, phone.c_str());
-        stmt.bind(4, address.c_str());
+        bindParameter(stmt, 0, firstName.c_str());
+        bindParameter(stmt, 1, lastName.c_str());
+        bindMasked(stmt, 2, email.c_str());
+        bindMasked(stmt, 3, phone.c_str());
+        bindParameter(stmt, 4, address.c_str());
         
-        nanodbc::execute(stmt);
+        executeStatement(stmt);
         log("Member created: " + firstName + " " + lastName);
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Create member failed: ") + e.what());
-        return false;
-    }
+    });
 }
 
 std::vector<Member> DBManager::getAllMembers() {
     std::vector<Member> members;
-    if (!isConnected()) return members;
-    
-    try {
-        nanodbc::result result = nanodbc::execute(*conn,
-            "SELECT MemberID, FirstName, LastName, Email, Phone, Address, "
-            "CONVERT(VARCHAR, MembershipDate, 23) AS MembershipDate, MembershipStatus "
-            "FROM Members ORDER BY LastName, FirstName");
-        
-        while (result.next()) {
-            Member member;
-            member.memberId = result.get<int>(0);
-            member.firstName = result.get<std::string>(1);
-            member.lastName = result.get<std::string>(2);
-            member.email = result.get<std::string>(3);
-            member.phone = result.get<std::string>(4, "");
-            member.address = result.get<std::string>(5, "");
-            member.membershipDate = result.get<std::string>(6);
-            member.membershipStatus = result.get<std::string>(7);
-            members.push_back(member);
-        }
-        
-        log("Retrieved " + std::to_string(members.size()) + " members");
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get all members failed: ") + e.what());
-    }
+    runRead("Get all members", [&](ConnectionLease& lease) {
+        members.clear();
+        static const std::string query =
+            "SELECT " + MemberMapper::selectList() + " "
+            "FROM Members ORDER BY LastName, FirstName";
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        nanodbc::result result = executeStatement(stmt, rowsetSize("Get all members"));
+        
+        while (fetchRow(result)) {
+            Member& member = members.emplace_back();
+            MemberMapper::decode(result, member);
+        }
+        
+        logDebug([&]() { return "Retrieved " + std::to_string(members.size()) + " members"; });
+    });
     
     return members;
 }
 
-Member DBManager::getMemberById(int memberId) {
-    Member member;
-    if (!isConnected()) return member;
+Page<Member, MemberCursor> DBManager::getMembersPage(const MemberCursor& after, int limit) {
+    Page<Member, MemberCursor> page;
+    if (limit <= 0) return page;
     
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "SELECT MemberID, FirstName, LastName, Email, Phone, Address, "
-                     "CONVERT(VARCHAR, MembershipDate, 23) AS MembershipDate, MembershipStatus "
-                     "FROM Members WHERE MemberID = ?");
-        
-        stmt.bind(0, &memberId);
-        nanodbc::result result = nanodbc::execute(stmt);
-        
-        if (result.next()) {
-            member.memberId = result.get<int>(0);
-            member.firstName = result.get<std::string>(1);
-            member.lastName = result.get<std::string>(2);
-            member.email = result.get<std::string>(3);
-            member.phone = result.get<std::string>(4, "");
-            member.address = result.get<std::string>(5, "");
-            member.membershipDate = result.get<std::string>(6);
-            member.membershipStatus = result.get<std::string>(7);
+    runRead("Get members page", [&](ConnectionLease& lease) {
+        page = Page<Member, MemberCursor>();
+        int fetch = limit + 1;
+        std::string query =
+            "SELECT TOP (?) " + MemberMapper::selectList() + " "
+            "FROM Members ";
+        if (!after.atStart()) {
+            query += "WHERE LastName > ? "
+                     "OR (LastName = ? AND FirstName > ?) "
+                     "OR (LastName = ? AND FirstName = ? AND MemberID > ?) ";
         }
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get member by ID failed: ") + e.what());
-    }
-    
-    return member;
-}
-
-bool DBManager::updateMemberStatus(int memberId, const std::string& status) {
-    if (!isConnected()) return false;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "UPDATE Members SET MembershipStatus = ? WHERE MemberID = ?");
+        query += "ORDER BY LastName, FirstName, MemberID";
         
-        stmt.bind(0, status.c_str());
-        stmt.bind(1, &memberId);
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        bindParameter(stmt, 0, &fetch);
+        if (!after.atStart()) {
+            bindParameter(stmt, 1, after.lastName.c_str());
+            bindParameter(stmt, 2, after.lastName.c_str());
+            bindParameter(stmt, 3, after.firstName.c_str());
+            bindParameter(stmt, 4, after.lastName.c_str());
+            bindParameter(stmt, 5, after.firstName.c_str());
+            bindParameter(stmt, 6, &after.memberId);
+        }
+        nanodbc::result result = executeStatement(stmt);
+        
+        while (fetchRow(result)) {
+            if (static_cast<int>(page.items.size()) == limit) {
+                page.hasMore = true;
+                break;
+            }
+            MemberMapper::decode(result, page.items.emplace_back());
+        }
+        
+        if (!page.items.empty()) {
+            const Member& last = page.items.back();
+            page.next.lastName = last.lastName;
+            page.next.firstName = last.firstName;
+            page.next.memberId = last.memberId;
+        }
+    });
+    
+    return page;
+}
+
+Member DBManager::getMemberById(int memberId) {
+    Member member;
+    runRead("Get member by ID", [&](ConnectionLease& lease) {
+        member = Member();
+        static const std::string query =
+            "SELECT " + MemberMapper::selectList() + " "
+            "FROM Members WHERE MemberID = ?";
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        
+        bindParameter(stmt, 0, &memberId);
+        nanodbc::result result = executeStatement(stmt);
+        
+        if (fetchRow(result)) {
+            MemberMapper::decode(result, member);
+        }
+    });
+    
+    return member;
+}
+
+bool DBManager::updateMemberStatus(int memberId, const std::string& status) {
+    return runWrite("Update member status", [&](ConnectionLease& lease) {
+        nanodbc::statement& stmt = prepareStatement(lease, "UPDATE Members SET MembershipStatus = ? WHERE MemberID = ?");
+        
+        bindParameter(stmt, 0, status.c_str());
+        bindParameter(stmt, 1, &memberId);
         
-        nanodbc::execute(stmt);
+        executeStatement(stmt);
         log("Member status updated: MemberID " + std::to_string(memberId) + ", Status: " + status);
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Update member status failed: ") + e.what());
-        return false;
-    }
+    });
 }
 
 // ============================================
@@ -491,56 +967,47 @@ bool DBManager::updateMemberStatus(int memberId, const std::string& status) {
 bool DBManager::createStaff(const std::string& firstName, const std::string& lastName,
                             const std::string& email, const std::string& phone,
                             const std::string& position, double salary) {
-    if (!isConnected()) return false;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "INSERT INTO Staff (FirstName, LastName, Email, Phone, Position, Salary) "
-                     "VALUES (?, ?, ?, ?, ?, ?)");
-        
-        stmt.bind(0, firstName.c_str());
-        stmt.bind(1, lastName.c_str());
-        stmt.bind(2, email.c_str());
-        stmt.bind(3, phone.c_str());
-        stmt.bind(4, position.c_str());
-        stmt.bind(5, &salary);
-        
-        nanodbc::execute(stmt);
+    return runWrite("Create staff", [&](ConnectionLease& lease) {
+        nanodbc::statement& stmt = prepareStatement(lease, 
+            "INSERT INTO Staff (FirstName, LastName, Email, Phone, Position, Salary) "
+            "VALUES (?, ?, ?, ?, ?, ?)");
+        
+        bindParameter(stmt, 0, firstName.c_str());
+        bindParameter(stmt, 1, lastName.c_str());
+        bindMasked(stmt, 2, email.c_str());
+        bindMasked(stmt, 3, phone.c_str());
+        bindParameter(stmt, 4, position.c_str());
+        bindParameter(stmt, 5, &salary);
+        
+        executeStatement(stmt);
         log("Staff created: " + firstName + " " + lastName);
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Create staff failed: ") + e.what());
-        return false;
-    }
+    });
 }
 
 std::vector<Staff> DBManager::getAllStaff() {
     std::vector<Staff> staffList;
-    if (!isConnected()) return staffList;
-    
-    try {
-        nanodbc::result result = nanodbc::execute(*conn,
+    runRead("Get all staff", [&](ConnectionLease& lease) {
+        staffList.clear();
+        nanodbc::statement& stmt = prepareStatement(lease, 
             "SELECT StaffID, FirstName, LastName, Email, Phone, Position, "
             "CONVERT(VARCHAR, HireDate, 23) AS HireDate, Salary "
             "FROM Staff ORDER BY LastName, FirstName");
+        nanodbc::result result = executeStatement(stmt, rowsetSize("Get all staff"));
         
-        while (result.next()) {
-            Staff staff;
-            staff.staffId = result.get<int>(0);
-            staff.firstName = result.get<std::string>(1);
-            staff.lastName = result.get<std::string>(2);
-            staff.email = result.get<std::string>(3);
-            staff.phone = result.get<std::string>(4, "");
-            staff.position = result.get<std::string>(5, "");
-            staff.hireDate = result.get<std::string>(6);
-            staff.salary = result.get<double>(7);
-            staffList.push_back(staff);
+        while (fetchRow(result)) {
+            Staff& staff = staffList.emplace_back();
+            result.get_ref(0, staff.staffId);
+            result.get_ref(1, staff.firstName);
+            result.get_ref(2, staff.lastName);
+            result.get_ref(3, staff.email);
+            result.get_ref(4, NO_VALUE, staff.phone);
+            result.get_ref(5, NO_VALUE, staff.position);
+            result.get_ref(6, staff.hireDate);
+            result.get_ref(7, staff.salary);
         }
         
-        log("Retrieved " + std::to_string(staffList.size()) + " staff members");
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get all staff failed: ") + e.what());
-    }
+        logDebug([&]() { return "Retrieved " + std::to_string(staffList.size()) + " staff members"; });
+    });
     
     return staffList;
 }
@@ -548,329 +1015,857 @@ std::vector<Staff> DBManager::getAllStaff() {
 // ============================================
 // Borrowing Operations
 // ============================================
-bool DBManager::createBorrowing(int bookId, int memberId, int staffId, 
-                                const std::string& dueDate) {
-    if (!isConnected()) return false;
-    
-    try {
-        // Start transaction
-        nanodbc::execute(*conn, "BEGIN TRANSACTION");
-        
-        // Insert borrowing
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "INSERT INTO Borrowings (BookID, MemberID, StaffID, DueDate) "
-                     "VALUES (?, ?, ?, ?)");
+const char* checkoutStatusMessage(CheckoutStatus status) {
+    switch (status) {
+        case CheckoutStatus::CheckedOut: return "Checked out";
+        case CheckoutStatus::NoCopiesAvailable: return "No copies available";
+        case CheckoutStatus::MemberNotActive: return "Membership is not active";
+        case CheckoutStatus::MemberNotFound: return "Member not found";
+        case CheckoutStatus::BookNotFound: return "Book not found";
+        case CheckoutStatus::Cancelled: return "Not checked out: another book in the batch failed";
+        case CheckoutStatus::Failed: break;
+    }
+    return "Database error";
+}
+
+// A code the procedures do not document (a newer schema, a bad row) is a failure
+static CheckoutStatus toCheckoutStatus(int code) {
+    if (code < static_cast<int>(CheckoutStatus::CheckedOut) || code > static_cast<int>(CheckoutStatus::Cancelled)) {
+        return CheckoutStatus::Failed;
+    }
+    return static_cast<CheckoutStatus>(code);
+}
+
+CheckoutResult DBManager::checkoutBook(int bookId, int memberId, int staffId,
+                                       const std::string& dueDate) {
+    CheckoutResult outcome;
+    bool done = runWrite("Create borrowing", [&](ConnectionLease& lease) {
+        outcome = CheckoutResult();
+        // The procedure runs its own transaction, so this is the only round trip
+        nanodbc::statement& stmt = prepareStatement(lease, "EXEC CheckoutBook ?, ?, ?, ?");
+        bindParameter(stmt, 0, &bookId);
+        bindParameter(stmt, 1, &memberId);
+        bindParameter(stmt, 2, &staffId);
+        bindParameter(stmt, 3, dueDate.c_str());
         
-        stmt.bind(0, &bookId);
-        stmt.bind(1, &memberId);
-        stmt.bind(2, &staffId);
-        stmt.bind(3, dueDate.c_str());
+        nanodbc::result result = executeStatement(stmt);
+        if (!fetchRow(result)) {
+            throw OperationFailed("CheckoutBook returned no result");
+        }
         
-        nanodbc::execute(stmt);
+        outcome.status = toCheckoutStatus(result.get<int>(0));
+        outcome.borrowingId = result.get<int>(1, 0);
         
-        // Update book availability
-        nanodbc::statement updateStmt(*conn);
-        prepare(updateStmt, "UPDATE Books SET AvailableCopies = AvailableCopies - 1, "
-                           "UpdatedAt = GETDATE() WHERE BookID = ? AND AvailableCopies > 0");
-        updateStmt.bind(0, &bookId);
-        nanodbc::execute(updateStmt);
+        if (outcome.ok()) {
+            log("Borrowing created: BookID " + std::to_string(bookId) + 
+                ", MemberID " + std::to_string(memberId) +
+                " (BorrowingID " + std::to_string(outcome.borrowingId) + ")");
+        } else {
+            log(std::string("Checkout refused: ") + checkoutStatusMessage(outcome.status) +
+                " (BookID " + std::to_string(bookId) + ", MemberID " + std::to_string(memberId) + ")");
+        }
+    });
+    
+    if (!done) outcome = CheckoutResult();
+    countCheckout(outcome.status);
+    return outcome;
+}
+
+bool DBManager::createBorrowing(int bookId, int memberId, int staffId, 
+                                const std::string& dueDate) {
+    return checkoutBook(bookId, memberId, staffId, dueDate).ok();
+}
+
+std::vector<CheckoutResult> DBManager::createBorrowings(int memberId, int staffId,
+                                                        const std::vector<int>& bookIds,
+                                                        const std::string& dueDate,
+                                                        BatchMode mode) {
+    std::vector<CheckoutResult> outcomes(bookIds.size());
+    if (bookIds.empty()) return outcomes;
+    
+    bool done = runWrite("Create borrowings", [&](ConnectionLease& lease) {
+        outcomes.assign(bookIds.size(), CheckoutResult());
+#ifndef NANODBC_DISABLE_MSSQL_TVP
+        std::vector<int> positions(bookIds.size());
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            positions[i] = static_cast<int>(i);
+        }
+        int allOrNothing = mode == BatchMode::AllOrNothing ? 1 : 0;
         
-        // Commit transaction
-        nanodbc::execute(*conn, "COMMIT TRANSACTION");
+        nanodbc::statement& stmt = prepareStatement(lease, "{CALL CheckoutBooks(?, ?, ?, ?, ?)}");
+        bindParameter(stmt, 0, &memberId);
+        bindParameter(stmt, 1, &staffId);
+        bindParameter(stmt, 2, dueDate.c_str());
+        {
+            noteTableParameter(3, bookIds.size());
+            nanodbc::table_valued_parameter rows(stmt, 3, bookIds.size());
+            rows.bind(0, positions.data(), positions.size());
+            rows.bind(1, bookIds.data(), bookIds.size());
+            rows.close();
+        }
+        bindParameter(stmt, 4, &allOrNothing);
         
-        log("Borrowing created: BookID " + std::to_string(bookId) + 
-            ", MemberID " + std::to_string(memberId));
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        try {
-            nanodbc::execute(*conn, "ROLLBACK TRANSACTION");
-        } catch (...) {}
-        logError(std::string("Create borrowing failed: ") + e.what());
-        return false;
+        nanodbc::result result = executeStatement(stmt);
+        while (fetchRow(result)) {
+            int position = result.get<int>(0);
+            if (position < 0 || static_cast<std::size_t>(position) >= outcomes.size()) continue;
+            CheckoutResult& item = outcomes[static_cast<std::size_t>(position)];
+            item.status = toCheckoutStatus(result.get<int>(1));
+            item.borrowingId = result.get<int>(2, 0);
+        }
+#else
+        // nanodbc built without SQL Server TVP support: one CheckoutBook per title
+        // inside a client-side transaction, which the procedure joins by savepoint
+        nanodbc::transaction transaction(lease.connection());
+        bool anyFailed = false;
+        for (std::size_t i = 0; i < bookIds.size(); ++i) {
+            int bookId = bookIds[i];
+            nanodbc::statement& stmt = prepareStatement(lease, "EXEC CheckoutBook ?, ?, ?, ?");
+            bindParameter(stmt, 0, &bookId);
+            bindParameter(stmt, 1, &memberId);
+            bindParameter(stmt, 2, &staffId);
+            bindParameter(stmt, 3, dueDate.c_str());
+            nanodbc::result result = executeStatement(stmt);
+            if (fetchRow(result)) {
+                outcomes[i].status = toCheckoutStatus(result.get<int>(0));
+                outcomes[i].borrowingId = result.get<int>(1, 0);
+            }
+            anyFailed = anyFailed || !outcomes[i].ok();
+        }
+        if (mode == BatchMode::AllOrNothing && anyFailed) {
+            transaction.rollback();
+            for (CheckoutResult& item : outcomes) {
+                if (item.ok()) {
+                    item.status = CheckoutStatus::Cancelled;
+                    item.borrowingId = 0;
+                }
+            }
+        } else {
+            transaction.commit();
+        }
+#endif
+    });
+    if (!done) outcomes.assign(bookIds.size(), CheckoutResult());
+    for (const CheckoutResult& item : outcomes) {
+        countCheckout(item.status);
+    }
+    if (!done) return outcomes;
+    
+    std::size_t checkedOut = 0;
+    for (const CheckoutResult& item : outcomes) {
+        if (item.ok()) ++checkedOut;
     }
+    log("Batch checkout for MemberID " + std::to_string(memberId) + ": " +
+        std::to_string(checkedOut) + " of " + std::to_string(bookIds.size()) + " books");
+    return outcomes;
 }
 
 std::vector<Borrowing> DBManager::getAllBorrowings() {
     std::vector<Borrowing> borrowings;
-    if (!isConnected()) return borrowings;
-    
-    try {
-        nanodbc::result result = nanodbc::execute(*conn,
-            "SELECT br.BorrowingID, br.BookID, b.Title, br.MemberID, "
-            "m.FirstName + ' ' + m.LastName AS MemberName, "
-            "CONVERT(VARCHAR, br.BorrowDate, 120) AS BorrowDate, "
-            "CONVERT(VARCHAR, br.DueDate, 120) AS DueDate, "
-            "CONVERT(VARCHAR, br.ReturnDate, 120) AS ReturnDate, br.Status "
+    runRead("Get all borrowings", [&](ConnectionLease& lease) {
+        borrowings.clear();
+        static const std::string query =
+            "SELECT " + BorrowingMapper::selectList() + " "
             "FROM Borrowings br "
             "INNER JOIN Books b ON br.BookID = b.BookID "
             "INNER JOIN Members m ON br.MemberID = m.MemberID "
-            "ORDER BY br.BorrowDate DESC");
-        
-        while (result.next()) {
-            Borrowing borrowing;
-            borrowing.borrowingId = result.get<int>(0);
-            borrowing.bookId = result.get<int>(1);
-            borrowing.bookTitle = result.get<std::string>(2);
-            borrowing.memberId = result.get<int>(3);
-            borrowing.memberName = result.get<std::string>(4);
-            borrowing.borrowDate = result.get<std::string>(5);
-            borrowing.dueDate = result.get<std::string>(6);
-            borrowing.returnDate = result.get<std::string>(7, "");
-            borrowing.status = result.get<std::string>(8);
-            borrowings.push_back(borrowing);
-        }
-        
-        log("Retrieved " + std::to_string(borrowings.size()) + " borrowings");
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get all borrowings failed: ") + e.what());
-    }
+            "ORDER BY br.BorrowDate DESC";
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        nanodbc::result result = executeStatement(stmt, rowsetSize("Get all borrowings"));
+        
+        while (fetchRow(result)) {
+            Borrowing& borrowing = borrowings.emplace_back();
+            BorrowingMapper::decode(result, borrowing);
+        }
+        
+        logDebug([&]() { return "Retrieved " + std::to_string(borrowings.size()) + " borrowings"; });
+    });
     
     return borrowings;
 }
 
+Page<Borrowing, BorrowingCursor> DBManager::getBorrowingsPage(const BorrowingCursor& after, int limit) {
+    Page<Borrowing, BorrowingCursor> page;
+    if (limit <= 0) return page;
+    
+    runRead("Get borrowings page", [&](ConnectionLease& lease) {
+        page = Page<Borrowing, BorrowingCursor>();
+        int fetch = limit + 1;
+        // The column after the mapped ones is the cursor key: BorrowDate at full precision
+        std::string query =
+            "SELECT TOP (?) " + BorrowingMapper::selectList() + ", "
+            "CONVERT(VARCHAR(27), br.BorrowDate, 121) AS BorrowDateKey "
+            "FROM Borrowings br "
+            "INNER JOIN Books b ON br.BookID = b.BookID "
+            "INNER JOIN Members m ON br.MemberID = m.MemberID ";
+        if (!after.atStart()) {
+            query += "WHERE br.BorrowDate < CONVERT(DATETIME2, ?, 121) "
+                     "OR (br.BorrowDate = CONVERT(DATETIME2, ?, 121) AND br.BorrowingID < ?) ";
+        }
+        query += "ORDER BY br.BorrowDate DESC, br.BorrowingID DESC";
+        
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        bindParameter(stmt, 0, &fetch);
+        if (!after.atStart()) {
+            bindParameter(stmt, 1, after.borrowDate.c_str());
+            bindParameter(stmt, 2, after.borrowDate.c_str());
+            bindParameter(stmt, 3, &after.borrowingId);
+        }
+        nanodbc::result result = executeStatement(stmt);
+        
+        while (fetchRow(result)) {
+            if (static_cast<int>(page.items.size()) == limit) {
+                page.hasMore = true;
+                break;
+            }
+            Borrowing& borrowing = page.items.emplace_back();
+            BorrowingMapper::decode(result, borrowing);
+            result.get_ref(static_cast<short>(BorrowingMapper::columnCount), page.next.borrowDate);
+            page.next.borrowingId = borrowing.borrowingId;
+        }
+    });
+    
+    return page;
+}
+
+bool DBManager::forEachBorrowing(const BorrowingFilter& filter,
+                                 const std::function<void(const Borrowing&)>& visit) {
+    return runRead("For each borrowing", [&](ConnectionLease& lease) {
+        std::string query =
+            "SELECT " + BorrowingMapper::selectList() + " "
+            "FROM Borrowings br "
+            "INNER JOIN Books b ON br.BookID = b.BookID "
+            "INNER JOIN Members m ON br.MemberID = m.MemberID "
+            "WHERE 1 = 1 ";
+        // Each filter shape is its own statement text, so each gets its own cached plan
+        if (filter.memberId != 0) query += "AND br.MemberID = ? ";
+        if (!filter.status.empty()) query += "AND br.Status = ? ";
+        if (filter.outstandingOnly) query += "AND br.Status IN ('Borrowed', 'Overdue') ";
+        query += "ORDER BY br.BorrowDate DESC";
+        
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        short param = 0;
+        if (filter.memberId != 0) bindParameter(stmt, param++, &filter.memberId);
+        if (!filter.status.empty()) bindParameter(stmt, param++, filter.status.c_str());
+        // A block cursor only when nothing is bound (see rowsetSize)
+        nanodbc::result result = executeStatement(stmt, param > 0 ? 1 : rowsetSize("For each borrowing"));
+        
+        Borrowing borrowing;
+        long rows = 0;
+        while (fetchRow(result)) {
+            BorrowingMapper::decode(result, borrowing);
+            visit(borrowing);
+            ++rows;
+        }
+        
+        logDebug([&]() { return "Streamed " + std::to_string(rows) + " borrowings"; });
+    }, false);
+}
+
 std::vector<Borrowing> DBManager::getCurrentBorrowings() {
     std::vector<Borrowing> borrowings;
-    if (!isConnected()) return borrowings;
-    
-    try {
-        nanodbc::result result = nanodbc::execute(*conn,
-            "SELECT BorrowingID, MemberName, Email, BookTitle, ISBN, "
-            "CONVERT(VARCHAR, BorrowDate, 120) AS BorrowDate, "
-            "CONVERT(VARCHAR, DueDate, 120) AS DueDate, DaysOverdue, Status "
-            "FROM CurrentBorrowings ORDER BY DaysOverdue DESC");
-        
-        while (result.next()) {
-            Borrowing borrowing;
-            borrowing.borrowingId = result.get<int>(0);
-            borrowing.memberName = result.get<std::string>(1);
-            borrowing.bookTitle = result.get<std::string>(3);
-            borrowing.borrowDate = result.get<std::string>(5);
-            borrowing.dueDate = result.get<std::string>(6);
-            borrowing.status = result.get<std::string>(8);
-            borrowings.push_back(borrowing);
-        }
-        
-        log("Retrieved " + std::to_string(borrowings.size()) + " current borrowings");
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get current borrowings failed: ") + e.what());
-    }
+    runRead("Get current borrowings", [&](ConnectionLease& lease) {
+        borrowings.clear();
+        static const std::string query =
+            "SELECT " + CurrentBorrowingMapper::selectList() + " "
+            "FROM CurrentBorrowings ORDER BY DaysOverdue DESC";
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        nanodbc::result result = executeStatement(stmt, rowsetSize("Get current borrowings"));
+        
+        while (fetchRow(result)) {
+            Borrowing& borrowing = borrowings.emplace_back();
+            CurrentBorrowingMapper::decode(result, borrowing);
+        }
+        
+        logDebug([&]() { return "Retrieved " + std::to_string(borrowings.size()) + " current borrowings"; });
+    });
     
     return borrowings;
 }
 
 std::vector<Borrowing> DBManager::getMemberBorrowings(int memberId) {
     std::vector<Borrowing> borrowings;
-    if (!isConnected()) return borrowings;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "EXEC GetMemberBorrowings ?");
-        stmt.bind(0, &memberId);
+    runRead("Get member borrowings", [&](ConnectionLease& lease) {
+        borrowings.clear();
+        nanodbc::statement& stmt = prepareStatement(lease, "EXEC GetMemberBorrowings ?");
+        bindParameter(stmt, 0, &memberId);
         
-        nanodbc::result result = nanodbc::execute(stmt);
+        nanodbc::result result = executeStatement(stmt);
         
-        while (result.next()) {
-            Borrowing borrowing;
-            borrowing.borrowingId = result.get<int>(0);
-            borrowing.bookTitle = result.get<std::string>(1);
-            borrowing.borrowDate = result.get<std::string>(4);
-            borrowing.dueDate = result.get<std::string>(5);
-            borrowing.returnDate = result.get<std::string>(6, "");
-            borrowing.status = result.get<std::string>(7);
-            borrowings.push_back(borrowing);
+        while (fetchRow(result)) {
+            Borrowing& borrowing = borrowings.emplace_back();
+            result.get_ref(0, borrowing.borrowingId);
+            result.get_ref(1, borrowing.bookTitle);
+            result.get_ref(4, borrowing.borrowDate);
+            result.get_ref(5, borrowing.dueDate);
+            result.get_ref(6, NO_VALUE, borrowing.returnDate);
+            result.get_ref(7, borrowing.status);
         }
         
-        log("Retrieved borrowings for MemberID " + std::to_string(memberId));
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get member borrowings failed: ") + e.what());
-    }
+        logDebug([&]() { return "Retrieved borrowings for MemberID " + std::to_string(memberId); });
+    });
     
     return borrowings;
 }
 
-bool DBManager::returnBook(int borrowingId) {
-    if (!isConnected()) return false;
-    
-    try {
-        nanodbc::execute(*conn, "BEGIN TRANSACTION");
-        
-        // Get BookID first
-        nanodbc::statement getStmt(*conn);
-        prepare(getStmt, "SELECT BookID FROM Borrowings WHERE BorrowingID = ?");
-        getStmt.bind(0, &borrowingId);
-        nanodbc::result res = nanodbc::execute(getStmt);
+const char* returnStatusMessage(ReturnStatus status) {
+    switch (status) {
+        case ReturnStatus::Returned: return "Returned";
+        case ReturnStatus::BorrowingNotFound: return "Borrowing not found";
+        case ReturnStatus::AlreadyReturned: return "Already returned";
+        case ReturnStatus::Failed: break;
+    }
+    return "Database error";
+}
+
+static ReturnStatus toReturnStatus(int code) {
+    if (code < static_cast<int>(ReturnStatus::Returned) || code > static_cast<int>(ReturnStatus::AlreadyReturned)) {
+        return ReturnStatus::Failed;
+    }
+    return static_cast<ReturnStatus>(code);
+}
+
+ReturnResult DBManager::returnBorrowing(int borrowingId) {
+    ReturnResult outcome;
+    bool done = runWrite("Return book", [&](ConnectionLease& lease) {
+        outcome = ReturnResult();
+        nanodbc::statement& stmt = prepareStatement(lease, "EXEC ReturnBook ?");
+        bindParameter(stmt, 0, &borrowingId);
         
-        if (!res.next()) {
-            nanodbc::execute(*conn, "ROLLBACK TRANSACTION");
-            return false;
+        nanodbc::result result = executeStatement(stmt);
+        if (!fetchRow(result)) {
+            throw OperationFailed("ReturnBook returned no result");
         }
-        int bookId = res.get<int>(0);
         
-        // Update borrowing
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "UPDATE Borrowings SET ReturnDate = GETDATE(), Status = 'Returned' "
-                     "WHERE BorrowingID = ?");
-        stmt.bind(0, &borrowingId);
-        nanodbc::execute(stmt);
+        outcome.status = toReturnStatus(result.get<int>(0));
+        outcome.bookId = result.get<int>(1, 0);
+        outcome.fulfilledReservationId = result.get<int>(2, 0);
         
-        // Update book availability
-        nanodbc::statement updateStmt(*conn);
-        prepare(updateStmt, "UPDATE Books SET AvailableCopies = AvailableCopies + 1, "
-                           "UpdatedAt = GETDATE() WHERE BookID = ?");
-        updateStmt.bind(0, &bookId);
-        nanodbc::execute(updateStmt);
+        if (outcome.ok()) {
+            log("Book returned: BorrowingID " + std::to_string(borrowingId));
+            if (outcome.fulfilledReservationId != 0) {
+                log("Reservation fulfilled: ReservationID " +
+                    std::to_string(outcome.fulfilledReservationId) +
+                    ", BookID " + std::to_string(outcome.bookId));
+            }
+        } else {
+            log(std::string("Return refused: ") + returnStatusMessage(outcome.status) +
+                " (BorrowingID " + std::to_string(borrowingId) + ")");
+        }
+    });
+    
+    if (!done) outcome = ReturnResult();
+    countReturn(outcome.status);
+    return outcome;
+}
+
+bool DBManager::returnBook(int borrowingId) {
+    return returnBorrowing(borrowingId).ok();
+}
+
+std::vector<ReturnResult> DBManager::returnBooks(const std::vector<int>& borrowingIds) {
+    std::vector<ReturnResult> outcomes(borrowingIds.size());
+    if (borrowingIds.empty()) return outcomes;
+    
+    // The table type has BorrowingID as its key, so send each ID once
+    std::vector<int> ids(borrowingIds);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    std::unordered_map<int, ReturnResult> byId;
+    
+#ifndef NANODBC_DISABLE_MSSQL_TVP
+    bool done = runWrite("Return books", [&](ConnectionLease& lease) {
+        byId.clear();
+        // ODBC call syntax lets the driver describe the table-valued parameter
+        nanodbc::statement& stmt = prepareStatement(lease, "{CALL ReturnBooks(?)}");
+        noteTableParameter(0, ids.size());
+        nanodbc::table_valued_parameter rows(stmt, 0, ids.size());
+        rows.bind(0, ids.data(), ids.size());
+        rows.close();
         
-        nanodbc::execute(*conn, "COMMIT TRANSACTION");
-        log("Book returned: BorrowingID " + std::to_string(borrowingId));
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        try {
-            nanodbc::execute(*conn, "ROLLBACK TRANSACTION");
-        } catch (...) {}
-        logError(std::string("Return book failed: ") + e.what());
-        return false;
+        nanodbc::result result = executeStatement(stmt);
+        while (fetchRow(result)) {
+            ReturnResult& item = byId[result.get<int>(0)];
+            item.status = toReturnStatus(result.get<int>(1));
+            item.bookId = result.get<int>(2, 0);
+            item.fulfilledReservationId = result.get<int>(3, 0);
+        }
+    });
+    // Each loan counts once, as the procedure reported it; the fallback below
+    // is counted by returnBorrowing
+    for (int id : ids) {
+        std::unordered_map<int, ReturnResult>::const_iterator it = byId.find(id);
+        countReturn(done && it != byId.end() ? it->second.status : ReturnStatus::Failed);
+    }
+    if (!done) return outcomes;
+#else
+    // nanodbc built without SQL Server TVP support: fall back to one call per item
+    for (int id : ids) {
+        byId[id] = returnBorrowing(id);
+    }
+#endif
+    
+    std::size_t returned = 0, handedOff = 0;
+    std::unordered_set<int> seen;
+    for (std::size_t i = 0; i < borrowingIds.size(); ++i) {
+        int id = borrowingIds[i];
+        std::unordered_map<int, ReturnResult>::const_iterator it = byId.find(id);
+        if (it == byId.end()) continue;   // stays Failed
+        outcomes[i] = it->second;
+        if (!seen.insert(id).second) {
+            // Same loan twice in one bin: only the first scan returned it
+            if (outcomes[i].ok()) {
+                outcomes[i].status = ReturnStatus::AlreadyReturned;
+                outcomes[i].fulfilledReservationId = 0;
+            }
+            continue;
+        }
+        if (outcomes[i].ok()) ++returned;
+        if (outcomes[i].fulfilledReservationId != 0) ++handedOff;
     }
+    
+    log("Batch return: " + std::to_string(returned) + " of " +
+        std::to_string(borrowingIds.size()) + " returned, " +
+        std::to_string(handedOff) + " reservations fulfilled");
+    return outcomes;
 }
 
 bool DBManager::markOverdueBooks() {
-    if (!isConnected()) return false;
-    
-    try {
-        nanodbc::execute(*conn, 
+    return runWrite("Mark overdue books", [&](ConnectionLease& lease) {
+        nanodbc::statement& stmt = prepareStatement(lease, 
             "UPDATE Borrowings SET Status = 'Overdue' "
             "WHERE Status = 'Borrowed' AND DueDate < GETDATE() AND ReturnDate IS NULL");
+        executeStatement(stmt);
         
         log("Marked overdue books");
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Mark overdue books failed: ") + e.what());
-        return false;
-    }
+    });
 }
 
 // ============================================
 // Reservation Operations
 // ============================================
 bool DBManager::createReservation(int bookId, int memberId) {
-    if (!isConnected()) return false;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "INSERT INTO Reservations (BookID, MemberID, ExpiryDate) "
-                     "VALUES (?, ?, DATEADD(DAY, 7, GETDATE()))");
+    return runWrite("Create reservation", [&](ConnectionLease& lease) {
+        nanodbc::statement& stmt = prepareStatement(lease, 
+            "INSERT INTO Reservations (BookID, MemberID, ExpiryDate) "
+            "VALUES (?, ?, DATEADD(DAY, 7, GETDATE()))");
         
-        stmt.bind(0, &bookId);
-        stmt.bind(1, &memberId);
+        bindParameter(stmt, 0, &bookId);
+        bindParameter(stmt, 1, &memberId);
         
-        nanodbc::execute(stmt);
+        executeStatement(stmt);
         log("Reservation created: BookID " + std::to_string(bookId) + 
             ", MemberID " + std::to_string(memberId));
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Create reservation failed: ") + e.what());
-        return false;
-    }
+    });
 }
 
 std::vector<Reservation> DBManager::getAllReservations() {
     std::vector<Reservation> reservations;
-    if (!isConnected()) return reservations;
-    
-    try {
-        nanodbc::result result = nanodbc::execute(*conn,
-            "SELECT r.ReservationID, r.BookID, b.Title, r.MemberID, "
-            "m.FirstName + ' ' + m.LastName AS MemberName, "
-            "CONVERT(VARCHAR, r.ReservationDate, 120) AS ReservationDate, "
-            "CONVERT(VARCHAR, r.ExpiryDate, 120) AS ExpiryDate, r.Status "
+    runRead("Get all reservations", [&](ConnectionLease& lease) {
+        reservations.clear();
+        static const std::string query =
+            "SELECT " + ReservationMapper::selectList() + " "
             "FROM Reservations r "
             "INNER JOIN Books b ON r.BookID = b.BookID "
             "INNER JOIN Members m ON r.MemberID = m.MemberID "
-            "ORDER BY r.ReservationDate DESC");
-        
-        while (result.next()) {
-            Reservation reservation;
-            reservation.reservationId = result.get<int>(0);
-            reservation.bookId = result.get<int>(1);
-            reservation.bookTitle = result.get<std::string>(2);
-            reservation.memberId = result.get<int>(3);
-            reservation.memberName = result.get<std::string>(4);
-            reservation.reservationDate = result.get<std::string>(5);
-            reservation.expiryDate = result.get<std::string>(6, "");
-            reservation.status = result.get<std::string>(7);
-            reservations.push_back(reservation);
-        }
-        
-        log("Retrieved " + std::to_string(reservations.size()) + " reservations");
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Get all reservations failed: ") + e.what());
-    }
+            "ORDER BY r.ReservationDate DESC";
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        nanodbc::result result = executeStatement(stmt, rowsetSize("Get all reservations"));
+        
+        while (fetchRow(result)) {
+            Reservation& reservation = reservations.emplace_back();
+            ReservationMapper::decode(result, reservation);
+        }
+        
+        logDebug([&]() { return "Retrieved " + std::to_string(reservations.size()) + " reservations"; });
+    });
     
     return reservations;
 }
 
-bool DBManager::cancelReservation(int reservationId) {
-    if (!isConnected()) return false;
+Page<Reservation, ReservationCursor> DBManager::getReservationsPage(const ReservationCursor& after, int limit) {
+    Page<Reservation, ReservationCursor> page;
+    if (limit <= 0) return page;
     
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "UPDATE Reservations SET Status = 'Cancelled' WHERE ReservationID = ?");
+    runRead("Get reservations page", [&](ConnectionLease& lease) {
+        page = Page<Reservation, ReservationCursor>();
+        int fetch = limit + 1;
+        // The column after the mapped ones is the cursor key: ReservationDate at full precision
+        std::string query =
+            "SELECT TOP (?) " + ReservationMapper::selectList() + ", "
+            "CONVERT(VARCHAR(27), r.ReservationDate, 121) AS ReservationDateKey "
+            "FROM Reservations r "
+            "INNER JOIN Books b ON r.BookID = b.BookID "
+            "INNER JOIN Members m ON r.MemberID = m.MemberID ";
+        if (!after.atStart()) {
+            query += "WHERE r.ReservationDate < CONVERT(DATETIME2, ?, 121) "
+                     "OR (r.ReservationDate = CONVERT(DATETIME2, ?, 121) AND r.ReservationID < ?) ";
+        }
+        query += "ORDER BY r.ReservationDate DESC, r.ReservationID DESC";
+        
+        nanodbc::statement& stmt = prepareStatement(lease, query);
+        bindParameter(stmt, 0, &fetch);
+        if (!after.atStart()) {
+            bindParameter(stmt, 1, after.reservationDate.c_str());
+            bindParameter(stmt, 2, after.reservationDate.c_str());
+            bindParameter(stmt, 3, &after.reservationId);
+        }
+        nanodbc::result result = executeStatement(stmt);
         
-        stmt.bind(0, &reservationId);
-        nanodbc::execute(stmt);
+        while (fetchRow(result)) {
+            if (static_cast<int>(page.items.size()) == limit) {
+                page.hasMore = true;
+                break;
+            }
+            Reservation& reservation = page.items.emplace_back();
+            ReservationMapper::decode(result, reservation);
+            result.get_ref(static_cast<short>(ReservationMapper::columnCount), page.next.reservationDate);
+            page.next.reservationId = reservation.reservationId;
+        }
+    });
+    
+    return page;
+}
+
+bool DBManager::cancelReservation(int reservationId) {
+    return runWrite("Cancel reservation", [&](ConnectionLease& lease) {
+        nanodbc::statement& stmt = prepareStatement(lease, "UPDATE Reservations SET Status = 'Cancelled' WHERE ReservationID = ?");
+        
+        bindParameter(stmt, 0, &reservationId);
+        executeStatement(stmt);
         
         log("Reservation cancelled: ReservationID " + std::to_string(reservationId));
-        return true;
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Cancel reservation failed: ") + e.what());
-        return false;
-    }
+    });
 }
 
 // ============================================
 // Stored Procedure Calls
 // ============================================
 int DBManager::executeUpdateOverdueBooks() {
-    if (!isConnected()) return -1;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "EXEC UpdateOverdueBooks");
-        nanodbc::result result = nanodbc::execute(stmt);
+    int count = -1;
+    runWrite("Execute UpdateOverdueBooks", [&](ConnectionLease& lease) {
+        count = -1;
+        nanodbc::statement& stmt = prepareStatement(lease, "EXEC UpdateOverdueBooks");
+        nanodbc::result result = executeStatement(stmt);
         
-        if (result.next()) {
-            int count = result.get<int>(0);
+        if (fetchRow(result)) {
+            count = result.get<int>(0);
             log("Updated " + std::to_string(count) + " overdue books");
-            return count;
         }
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Execute UpdateOverdueBooks failed: ") + e.what());
-    }
+    });
     
-    return -1;
+    return count;
 }
 
 int DBManager::executeCalculateOverdueFines(double dailyRate) {
-    if (!isConnected()) return -1;
-    
-    try {
-        nanodbc::statement stmt(*conn);
-        prepare(stmt, "EXEC CalculateOverdueFines ?");
+    int count = -1;
+    runWrite("Execute CalculateOverdueFines", [&](ConnectionLease& lease) {
+        count = -1;
+        nanodbc::statement& stmt = prepareStatement(lease, "EXEC CalculateOverdueFines ?");
         
-        stmt.bind(0, &dailyRate);
-        nanodbc::result result = nanodbc::execute(stmt);
+        bindParameter(stmt, 0, &dailyRate);
+        nanodbc::result result = executeStatement(stmt);
         
-        if (result.next()) {
-            int count = result.get<int>(0);
+        if (fetchRow(result)) {
+            count = result.get<int>(0);
             log("Calculated fines for " + std::to_string(count) + " borrowings");
-            return count;
         }
-    } catch (const nanodbc::database_error& e) {
-        logError(std::string("Execute CalculateOverdueFines failed: ") + e.what());
-    }
+    });
     
-    return -1;
+    return count;
+}
+
+// ============================================
+// Asynchronous Operations
+// ============================================
+std::future<std::vector<Book>> DBManager::getAllBooksAsync() {
+    return runAsync([this]() { return getAllBooks(); });
+}
+
+std::future<std::vector<Book>> DBManager::getAvailableBooksAsync() {
+    return runAsync([this]() { return getAvailableBooks(); });
+}
+
+std::future<std::vector<Book>> DBManager::searchBooksByTitleAsync(const std::string& title) {
+    return runAsync([this, title]() { return searchBooksByTitle(title); });
+}
+
+std::future<Book> DBManager::getBookByIdAsync(int bookId) {
+    return runAsync([this, bookId]() { return getBookById(bookId); });
+}
+
+std::future<std::vector<Member>> DBManager::getAllMembersAsync() {
+    return runAsync([this]() { return getAllMembers(); });
+}
+
+std::future<Member> DBManager::getMemberByIdAsync(int memberId) {
+    return runAsync([this, memberId]() { return getMemberById(memberId); });
+}
+
+std::future<std::vector<Borrowing>> DBManager::getAllBorrowingsAsync() {
+    return runAsync([this]() { return getAllBorrowings(); });
+}
+
+std::future<std::vector<Borrowing>> DBManager::getCurrentBorrowingsAsync() {
+    return runAsync([this]() { return getCurrentBorrowings(); });
+}
+
+std::future<std::vector<Borrowing>> DBManager::getMemberBorrowingsAsync(int memberId) {
+    return runAsync([this, memberId]() { return getMemberBorrowings(memberId); });
+}
+
+std::future<std::vector<Reservation>> DBManager::getAllReservationsAsync() {
+    return runAsync([this]() { return getAllReservations(); });
+}
+
+std::future<bool> DBManager::createBorrowingAsync(int bookId, int memberId, int staffId,
+                                                  const std::string& dueDate) {
+    return runAsync([this, bookId, memberId, staffId, dueDate]() {
+        return createBorrowing(bookId, memberId, staffId, dueDate);
+    });
+}
+
+std::future<bool> DBManager::returnBookAsync(int borrowingId) {
+    return runAsync([this, borrowingId]() { return returnBook(borrowingId); });
+}
+
+void DBManager::post(std::function<void()> job) {
+    workQueue().post(std::move(job));
 }
 
 std::string DBManager::getLastError() const {
     return "Check library_db.log for detailed error information";
 }
+
+LoggerStats DBManager::getLoggerStats() const {
+    return logger.stats();
+}
+
+void DBManager::flushLog() {
+    logger.flush();
+    slowQueryLog.flush();
+}
+
+void DBManager::setLogRotation(const LogRotationPolicy& policy) {
+    logger.setRotationPolicy(policy);
+}
+
+StatementCacheStats DBManager::getStatementCacheStats() const {
+    std::shared_ptr<ConnectionPool> current = currentPool();
+    return current ? current->statementCacheStats() : StatementCacheStats();
+}
+
+std::vector<OperationSummary> DBManager::getOperationStats() const {
+    return operationStats.snapshot();
+}
+
+void DBManager::resetOperationStats() {
+    operationStats.reset();
+}
+
+void DBManager::setSlowQueryPolicy(const SlowQueryPolicy& policy) {
+    slowQueryLog.setPolicy(policy);
+}
+
+std::vector<QuerySummary> DBManager::getQueryStats() const {
+    return queryStats.snapshot();
+}
+
+bool DBManager::exportQueryStats(const std::string& path, QueryStatsFormat format) {
+    std::vector<QuerySummary> rows = queryStats.snapshot();
+    std::ofstream out(path.c_str());
+    if (out) {
+        if (format == QueryStatsFormat::Json) QueryStats::writeJson(out, rows);
+        else QueryStats::writeCsv(out, rows);
+        out.flush();
+    }
+    if (!out) {
+        logError("Could not write query statistics to " + path);
+        return false;
+    }
+    log("Query statistics (" + std::to_string(rows.size()) + " fingerprints) written to " + path);
+    return true;
+}
+
+void DBManager::resetQueryStats() {
+    queryStats.reset();
+}
+
+bool DBManager::startTrace(const std::string& path) {
+    if (!tracer.start(path)) {
+        logError("Could not create trace file " + path);
+        return false;
+    }
+    log("Tracing to " + path);
+    return true;
+}
+
+void DBManager::stopTrace() {
+    if (!tracer.isActive()) return;
+    tracer.stop();
+    log("Tracing stopped");
+}
+
+// ============================================
+// Metrics
+// ============================================
+static const char* checkoutStatusLabel(CheckoutStatus status) {
+    switch (status) {
+        case CheckoutStatus::CheckedOut: return "checked_out";
+        case CheckoutStatus::NoCopiesAvailable: return "no_copies_available";
+        case CheckoutStatus::MemberNotActive: return "member_not_active";
+        case CheckoutStatus::MemberNotFound: return "member_not_found";
+        case CheckoutStatus::BookNotFound: return "book_not_found";
+        case CheckoutStatus::Cancelled: return "cancelled";
+        case CheckoutStatus::Failed: break;
+    }
+    return "failed";
+}
+
+static const char* returnStatusLabel(ReturnStatus status) {
+    switch (status) {
+        case ReturnStatus::Returned: return "returned";
+        case ReturnStatus::BorrowingNotFound: return "borrowing_not_found";
+        case ReturnStatus::AlreadyReturned: return "already_returned";
+        case ReturnStatus::Failed: break;
+    }
+    return "failed";
+}
+
+void DBManager::countCheckout(CheckoutStatus status) {
+    int index = static_cast<int>(status) + 1;
+    if (index < 0 || index >= 7) index = 0;   // an unknown code from the procedure counts as failed
+    checkoutCounters[index].add();
+}
+
+void DBManager::countReturn(ReturnStatus status) {
+    int index = static_cast<int>(status) + 1;
+    if (index < 0 || index >= 4) index = 0;
+    returnCounters[index].add();
+}
+
+void DBManager::registerMetrics() {
+    for (int i = 0; i < 7; ++i) {
+        checkoutCounters[i] = metrics.counter("library_checkouts_total", "Book checkouts by result",
+            MetricLabels{{"result", checkoutStatusLabel(static_cast<CheckoutStatus>(i - 1))}});
+    }
+    for (int i = 0; i < 4; ++i) {
+        returnCounters[i] = metrics.counter("library_returns_total", "Book returns by result",
+            MetricLabels{{"result", returnStatusLabel(static_cast<ReturnStatus>(i - 1))}});
+    }
+    
+    // Everything below is kept by its owner anyway and only read when scraped
+    metrics.addCollector([this](MetricsWriter& out) {
+        std::vector<OperationSummary> operations = operationStats.snapshot();
+        out.family("library_db_operations_total", "DBManager operations by name", MetricType::Counter);
+        for (const OperationSummary& op : operations) {
+            out.sample("library_db_operations_total", MetricLabels{{"operation", op.operation}},
+                       static_cast<std::uint64_t>(op.calls));
+        }
+        out.family("library_db_operation_errors_total", "DBManager operations that failed",
+                   MetricType::Counter);
+        for (const OperationSummary& op : operations) {
+            out.sample("library_db_operation_errors_total", MetricLabels{{"operation", op.operation}},
+                       static_cast<std::uint64_t>(op.errors));
+        }
+        out.family("library_db_operation_duration_seconds",
+                   "DBManager operation latency as the caller sees it", MetricType::Summary);
+        for (const OperationSummary& op : operations) {
+            const std::pair<const char*, std::uint64_t> quantiles[] = {
+                {"0.5", op.p50Micros}, {"0.9", op.p90Micros}, {"0.99", op.p99Micros}
+            };
+            for (const auto& quantile : quantiles) {
+                out.sample("library_db_operation_duration_seconds",
+                           MetricLabels{{"operation", op.operation}, {"quantile", quantile.first}},
+                           static_cast<double>(quantile.second) * 1e-6);
+            }
+            out.sample("library_db_operation_duration_seconds_sum", MetricLabels{{"operation", op.operation}},
+                       op.meanMicros * static_cast<double>(op.calls) * 1e-6);
+            out.sample("library_db_operation_duration_seconds_count", MetricLabels{{"operation", op.operation}},
+                       static_cast<std::uint64_t>(op.calls));
+        }
+    });
+    
+    metrics.addCollector([this](MetricsWriter& out) {
+        PoolStats poolStats = getPoolStats();
+        out.family("library_db_connected", "1 while connected to the database", MetricType::Gauge);
+        out.sample("library_db_connected", MetricLabels(), static_cast<std::uint64_t>(isConnected() ? 1 : 0));
+        out.family("library_db_pool_connections", "Open pooled connections by state", MetricType::Gauge);
+        out.sample("library_db_pool_connections", MetricLabels{{"state", "in_use"}},
+                   static_cast<std::uint64_t>(poolStats.inUse));
+        out.sample("library_db_pool_connections", MetricLabels{{"state", "idle"}},
+                   static_cast<std::uint64_t>(poolStats.idle));
+        
+        // Pool counters start again from zero when connect() builds a new pool
+        const struct {
+            const char* name;
+            const char* help;
+            std::size_t value;
+        } counters[] = {
+            {"library_db_pool_checkouts_total", "Connections leased from the pool", poolStats.checkouts},
+            {"library_db_pool_returns_total", "Leased connections given back to the pool", poolStats.returns},
+            {"library_db_pool_checkout_timeouts_total", "Leases that timed out waiting for a connection",
+             poolStats.timeouts},
+            {"library_db_pool_connections_opened_total", "Connections opened by the pool", poolStats.created},
+            {"library_db_pool_idle_evictions_total", "Idle connections closed after idleTimeout",
+             poolStats.evicted},
+            {"library_db_pool_validation_failures_total", "Idle connections that failed the checkout ping",
+             poolStats.validationFailures}
+        };
+        for (const auto& counter : counters) {
+            out.family(counter.name, counter.help, MetricType::Counter);
+            out.sample(counter.name, MetricLabels(), static_cast<std::uint64_t>(counter.value));
+        }
+        
+        StatementCacheStats cache = getStatementCacheStats();
+        out.family("library_db_statement_cache_hits_total", "Prepared statements reused", MetricType::Counter);
+        out.sample("library_db_statement_cache_hits_total", MetricLabels(), static_cast<std::uint64_t>(cache.hits));
+        out.family("library_db_statement_cache_misses_total", "Statements prepared for the first time on a connection",
+                   MetricType::Counter);
+        out.sample("library_db_statement_cache_misses_total", MetricLabels(),
+                   static_cast<std::uint64_t>(cache.misses));
+        out.family("library_db_statement_cache_statements", "Prepared statements held by open connections",
+                   MetricType::Gauge);
+        out.sample("library_db_statement_cache_statements", MetricLabels(), static_cast<std::uint64_t>(cache.size));
+        
+        WriteRetryStats retries = getWriteRetryStats();
+        out.family("library_db_write_retries_total", "Writes re-run after a deadlock or lock timeout",
+                   MetricType::Counter);
+        out.sample("library_db_write_retries_total", MetricLabels(), static_cast<std::uint64_t>(retries.retries));
+        out.family("library_db_write_give_ups_total", "Writes that still failed after every retry",
+                   MetricType::Counter);
+        out.sample("library_db_write_give_ups_total", MetricLabels(), static_cast<std::uint64_t>(retries.giveUps));
+    });
+    
+    metrics.addCollector([this](MetricsWriter& out) {
+        LoggerStats stats = logger.stats();
+        out.family("library_log_lines_written_total", "Lines written to library_db.log", MetricType::Counter);
+        out.sample("library_log_lines_written_total", MetricLabels(), static_cast<std::uint64_t>(stats.written));
+        out.family("library_log_lines_dropped_total", "Log lines dropped because the buffer was full",
+                   MetricType::Counter);
+        out.sample("library_log_lines_dropped_total", MetricLabels(), static_cast<std::uint64_t>(stats.dropped));
+        out.family("library_log_rotations_total", "Times library_db.log was rotated", MetricType::Counter);
+        out.sample("library_log_rotations_total", MetricLabels(), static_cast<std::uint64_t>(stats.rotations));
+        out.family("library_log_queue_depth", "Log lines waiting for the writer thread", MetricType::Gauge);
+        out.sample("library_log_queue_depth", MetricLabels(), static_cast<std::uint64_t>(stats.queued));
+    });
+}
+
+std::string DBManager::getMetricsText() const {
+    return metrics.scrape();
+}
+
+bool DBManager::startMetricsExport(const std::string& path, std::chrono::seconds interval) {
+    if (!metrics.startExport(path, interval)) {
+        logError("Could not write metrics to " + path);
+        return false;
+    }
+    log("Writing metrics to " + path + " every " + std::to_string(interval.count()) + " s");
+    return true;
+}
+
+void DBManager::stopMetricsExport() {
+    if (!metrics.isExporting()) return;
+    metrics.stopExport();
+    log("Metrics export stopped");
+}
@@ -3,9 +3,25 @@
 #define DBMANAGER_H
 
 #include <nanodbc/nanodbc.h>
+#include "ConnectionPool.h"
+#include "WorkQueue.h"
+#include "Backoff.h"
+#include "Page.h"
+#include "TransactionScope.h"
+#include "AsyncLogger.h"
+#include "OperationStats.h"
+#include "SlowQueryLog.h"
+#include "QueryStats.h"
+#include "Tracer.h"
+#include "Metrics.h"
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <unordered_map>
+#include <atomic>
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
@@ -18,14 +34,204 @@ class Staff;
 class Borrowing;
 class Reservation;
 
+struct ReconnectPolicy {
+    BackoffPolicy backoff;   // pacing of reconnect attempts after the link drops
+    int readRetries;         // times an idempotent read is re-run after a successful reconnect
+    
+    ReconnectPolicy() : readRetries(1) {}
+};
+
+// Writes that lose a deadlock or a lock wait are run again from the start on a
+// fresh lease. The failed attempt is rolled back first, so nothing applies twice.
+struct WriteRetryPolicy {
+    BackoffPolicy backoff;                     // maxAttempts includes the first try
+    std::vector<std::string> retryableStates;  // SQLSTATEs; 40001 = serialization failure / deadlock
+    std::vector<int> retryableNativeCodes;     // SQL Server errors; 1205 = deadlock victim, 1222 = lock timeout
+    
+    WriteRetryPolicy() : retryableStates{"40001"}, retryableNativeCodes{1205, 1222} {
+        backoff.maxAttempts = 4;
+        backoff.initialDelay = std::chrono::milliseconds(25);
+        backoff.maxDelay = std::chrono::milliseconds(1000);
+    }
+};
+
+struct WriteRetryStats {
+    unsigned long long retries;   // attempts re-run after a retryable error
+    unsigned long long giveUps;   // writes that still failed that way after maxAttempts
+    
+    WriteRetryStats() : retries(0), giveUps(0) {}
+};
+
+struct BulkRowError {
+    std::size_t index;       // position in the input vector
+    std::string message;
+    
+    BulkRowError() : index(0) {}
+    BulkRowError(std::size_t i, const std::string& msg) : index(i), message(msg) {}
+};
+
+struct BulkInsertResult {
+    bool committed;          // false if the whole import was rolled back
+    std::size_t inserted;
+    std::vector<BulkRowError> failures;
+    
+    BulkInsertResult() : committed(false), inserted(0) {}
+};
+
+// Outcome of the CheckoutBook procedure; values match its result codes
+enum class CheckoutStatus {
+    CheckedOut = 0,
+    NoCopiesAvailable = 1,
+    MemberNotActive = 2,
+    MemberNotFound = 3,
+    BookNotFound = 4,
+    Cancelled = 5,           // all-or-nothing batch where another book failed
+    Failed = -1              // database error, already logged
+};
+
+enum class BatchMode {
+    AllOrNothing,            // any failure leaves every book on the shelf
+    BestEffort               // check out whatever can be checked out
+};
+
+struct CheckoutResult {
+    CheckoutStatus status;
+    int borrowingId;         // set when status is CheckedOut
+    
+    CheckoutResult() : status(CheckoutStatus::Failed), borrowingId(0) {}
+    bool ok() const { return status == CheckoutStatus::CheckedOut; }
+};
+
+const char* checkoutStatusMessage(CheckoutStatus status);
+
+// Outcome of the ReturnBook procedure; values match its result codes
+enum class ReturnStatus {
+    Returned = 0,
+    BorrowingNotFound = 1,
+    AlreadyReturned = 2,
+    Failed = -1              // database error, already logged
+};
+
+struct ReturnResult {
+    ReturnStatus status;
+    int bookId;
+    int fulfilledReservationId;   // Pending reservation handed this copy, 0 if none
+    
+    ReturnResult() : status(ReturnStatus::Failed), bookId(0), fulfilledReservationId(0) {}
+    bool ok() const { return status == ReturnStatus::Returned; }
+};
+
+const char* returnStatusMessage(ReturnStatus status);
+
+// Narrows forEachBorrowing; default-constructed matches every borrowing
+struct BorrowingFilter {
+    int memberId;            // 0 = any member
+    std::string status;      // "Borrowed", "Returned", "Overdue", "Lost"; empty = any
+    bool outstandingOnly;    // only Borrowed or Overdue (not yet returned)
+    
+    BorrowingFilter() : memberId(0), outstandingOnly(false) {}
+};
+
+// Thread safety: one DBManager may be shared by any number of threads.
+// Every operation leases its own pooled connection, so read operations
+// (getAllBooks, searchBooksByTitle, getMemberById, getCurrentBorrowings, ...)
+// run concurrently, up to PoolConfig::maxSize at a time; further callers
+// wait up to PoolConfig::checkoutTimeout. Checkout and return run inside the
+// CheckoutBook(s)/ReturnBook(s) procedures; other multi-statement writes
+// (createBooksBulk) run their whole transaction on one leased connection,
+// so concurrent writers never share a transaction.
+// A write chosen as a deadlock victim is rolled back and run again
+// (WriteRetryPolicy) instead of failing the desk operation.
+// To group several calls into one commit, see TransactionScope.
+// connect()/disconnect() may race with running operations: calls already in
+// flight finish on the old pool, new calls see the new state.
 class DBManager {
 private:
-    std::unique_ptr<nanodbc::connection> conn;
+    friend class TransactionScope;
+    
+    std::shared_ptr<ConnectionPool> pool;
+    PoolConfig poolConfig;
+    ReconnectPolicy reconnectPolicy;
+    WriteRetryPolicy writeRetryPolicy;
+    long defaultRowsetSize;
+    std::unordered_map<std::string, long> rowsetSizes;   // per-operation overrides
     std::string connectionString;
-    std::ofstream logFile;
+    mutable std::mutex poolMutex;   // guards pool, poolConfig, both retry policies, rowset sizes and connectionString
+    std::mutex reconnectMutex;      // one thread runs the backoff loop, the rest wait for its outcome
+    std::atomic<unsigned long long> writeRetries;
+    std::atomic<unsigned long long> writeGiveUps;
+    
+    AsyncLogger logger;             // library_db.log, written off the calling thread
+    std::mutex consoleMutex;        // keeps concurrent error lines on stderr whole
+    OperationStats operationStats;  // latency per runRead/runWrite operation name
+    SlowQueryLog slowQueryLog;      // library_db_slow.log
+    QueryStats queryStats;          // totals per statement fingerprint
+    Tracer tracer;                  // Chrome trace file, while one is running
+    MetricsRegistry metrics;        // Prometheus counters, plus collectors reading the stats above
+    StatementMetrics statementMetrics;       // statement counts and phase times into metrics
+    StatementObservers statementObservers;   // slow log, query stats, tracer and statement metrics
+    Counter checkoutCounters[7];    // library_checkouts_total by CheckoutStatus + 1
+    Counter returnCounters[4];      // library_returns_total by ReturnStatus + 1
+    
+    // Worker threads behind the *Async API (blocking calls, one per thread), started on first use
+    std::unique_ptr<WorkQueue> workers;
+    std::mutex workersMutex;
+    
+    std::shared_ptr<ConnectionPool> currentPool() const;
+    WorkQueue& workQueue();
+    
+    // Runs fn on a worker thread; the future carries its result or exception
+    template <typename Fn>
+    auto runAsync(Fn fn) -> std::future<decltype(fn())> {
+        using Result = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fn));
+        std::future<Result> result = task->get_future();
+        workQueue().post([task]() { (*task)(); });
+        return result;
+    }
     
     void log(const std::string& message);
     void logError(const std::string& error);
+    // Per-query detail; compiled out unless LIBRARY_LOG_MIN_LEVEL is 0, and the
+    // message is only built when it is kept
+    template <typename MakeMessage>
+    void logDebug(MakeMessage makeMessage) {
+        if (logLevelEnabled(LogLevel::Debug)) logger.write(LogLevel::Debug, makeMessage());
+    }
+    
+    // Leases a pooled connection for one operation; empty lease on failure (already logged)
+    ConnectionLease acquireConnection();
+    
+    // Runs an idempotent read. If the connection drops, reconnects and runs body
+    // again (up to ReconnectPolicy::readRetries), so body must reset its outputs.
+    // A body that hands rows to the caller as they arrive passes rerunnable = false
+    // and fails instead. Other errors are logged as "<operation> failed: ...".
+    // Returns true on success.
+    bool runRead(const std::string& operation,
+                 const std::function<void(ConnectionLease&)>& body,
+                 bool rerunnable = true);
+    
+    // Runs a write on its own lease. On any error an open transaction is rolled
+    // back; deadlocks and lock timeouts (WriteRetryPolicy) then re-run body after
+    // a backoff delay, so body must reset its outputs. Other errors are logged as
+    // "<operation> failed: ...". Returns true on success.
+    bool runWrite(const std::string& operation,
+                  const std::function<void(ConnectionLease&)>& body);
+    bool isRetryableWriteError(const nanodbc::database_error& e) const;
+    
+    // runRead/runWrite inside a TransactionScope: the scope's connection, one attempt
+    bool runInScope(TransactionScope& scope, const std::string& operation,
+                    const std::function<void(ConnectionLease&)>& body, bool isWrite);
+    
+    // Rows fetched per driver call for a list query (its runRead operation name).
+    // Only for statements without parameters: nanodbc passes the same count to
+    // the driver as the parameter array size, which would read past a bound
+    // scalar, so anything with a bound parameter executes with 1.
+    long rowsetSize(const std::string& operation) const;
+    
+    void registerMetrics();
+    void countCheckout(CheckoutStatus status);
+    void countReturn(ReturnStatus status);
 
 public:
     // Constructor/Destructor
@@ -38,6 +244,27 @@ public:
     bool isConnected() const;
     bool testConnection();
     
+    // Pool sizing applies to the next connect()
+    void setPoolConfig(const PoolConfig& config);
+    PoolStats getPoolStats() const;
+    
+    // Re-establishes the link using the stored connection string, retrying with
+    // jittered exponential backoff. Called automatically when a read hits a
+    // dropped connection; does nothing after an explicit disconnect().
+    bool reconnect();
+    void setReconnectPolicy(const ReconnectPolicy& policy);
+    
+    // Deadlock / lock-timeout retry for every write operation
+    void setWriteRetryPolicy(const WriteRetryPolicy& policy);
+    WriteRetryStats getWriteRetryStats() const;
+    
+    // Block-cursor size for list queries without parameters (all books, all
+    // members, current borrowings, ...): the default, or an override for one
+    // operation by name (e.g. "Get all borrowings"). 1 fetches row by row.
+    // Searches and other queries with bound parameters always fetch row by row.
+    void setRowsetSize(long rows);
+    void setRowsetSize(const std::string& operation, long rows);
+    
     // Category operations
     bool createCategory(const std::string& name, const std::string& description);
     std::vector<Category> getAllCategories();
@@ -47,7 +274,20 @@ public:
                     const std::string& author, const std::string& publisher,
                     int year, int categoryId, int totalCopies, 
                     double price, const std::string& shelfLocation);
+    // Inserts all books in one transaction, binding chunkSize rows per round trip.
+    // A failing chunk is rolled back to a savepoint and replayed row by row, so
+    // good rows still land and each bad row is reported in failures.
+    BulkInsertResult createBooksBulk(const std::vector<Book>& books,
+                                     std::size_t chunkSize = 1000);
     std::vector<Book> getAllBooks();
+    // Keyset pages of the getAll* listings, in the same order; see Page.h
+    Page<Book, BookCursor> getBooksPage(const BookCursor& after, int limit);
+    // Streams every book (in getAllBooks order) to visit without building a
+    // vector; the Book reference is reused and only valid during the call.
+    // Not retried on a dropped connection, since rows may already be consumed.
+    // Inside a TransactionScope it streams on the scope's connection, so visit
+    // must not call back into this DBManager until it returns.
+    bool forEachBook(const std::function<void(const Book&)>& visit);
     std::vector<Book> getAvailableBooks();
     std::vector<Book> searchBooksByTitle(const std::string& title);
     Book getBookById(int bookId);
@@ -59,6 +299,7 @@ public:
                       const std::string& email, const std::string& phone,
                       const std::string& address);
     std::vector<Member> getAllMembers();
+    Page<Member, MemberCursor> getMembersPage(const MemberCursor& after, int limit);
     Member getMemberById(int memberId);
     bool updateMemberStatus(int memberId, const std::string& status);
     
@@ -69,25 +310,108 @@ public:
     std::vector<Staff> getAllStaff();
     
     // Borrowing operations
+    // Checks the member and takes a copy in one call to CheckoutBook
+    CheckoutResult checkoutBook(int bookId, int memberId, int staffId,
+                                const std::string& dueDate);
     bool createBorrowing(int bookId, int memberId, int staffId, 
                          const std::string& dueDate);
+    // A member's stack of books in one transaction and one round trip via the
+    // CheckoutBooks procedure; the member is validated once. Results are in
+    // bookIds order. On a database error every item is Failed.
+    std::vector<CheckoutResult> createBorrowings(int memberId, int staffId,
+                                                 const std::vector<int>& bookIds,
+                                                 const std::string& dueDate,
+                                                 BatchMode mode = BatchMode::AllOrNothing);
     std::vector<Borrowing> getAllBorrowings();
+    Page<Borrowing, BorrowingCursor> getBorrowingsPage(const BorrowingCursor& after, int limit);
+    // Streaming counterpart of getAllBorrowings, same rules as forEachBook
+    bool forEachBorrowing(const BorrowingFilter& filter,
+                          const std::function<void(const Borrowing&)>& visit);
     std::vector<Borrowing> getCurrentBorrowings();
     std::vector<Borrowing> getMemberBorrowings(int memberId);
+    // Return, copy hand-back and reservation fulfilment in one call to ReturnBook
+    ReturnResult returnBorrowing(int borrowingId);
+    // Drop-box batch: every return in one transaction and one round trip via the
+    // ReturnBooks procedure. Results are in input order; a repeated ID reports
+    // AlreadyReturned. On a database error every item is Failed.
+    std::vector<ReturnResult> returnBooks(const std::vector<int>& borrowingIds);
     bool returnBook(int borrowingId);
     bool markOverdueBooks();
     
     // Reservation operations
     bool createReservation(int bookId, int memberId);
     std::vector<Reservation> getAllReservations();
+    Page<Reservation, ReservationCursor> getReservationsPage(const ReservationCursor& after, int limit);
     bool cancelReservation(int reservationId);
     
     // Stored procedure calls
     int executeUpdateOverdueBooks();
     int executeCalculateOverdueFines(double dailyRate = 1.0);
     
+    // Asynchronous variants, backed by a thread pool rather than ODBC async
+    // execution: each call is queued to one of PoolConfig::maxSize worker
+    // threads, which runs the ordinary blocking method on its own pooled
+    // connection. The caller does not wait, but every query in flight still
+    // occupies a worker, so at most maxSize run at once and the rest queue.
+    std::future<std::vector<Book>> getAllBooksAsync();
+    std::future<std::vector<Book>> getAvailableBooksAsync();
+    std::future<std::vector<Book>> searchBooksByTitleAsync(const std::string& title);
+    std::future<Book> getBookByIdAsync(int bookId);
+    std::future<std::vector<Member>> getAllMembersAsync();
+    std::future<Member> getMemberByIdAsync(int memberId);
+    std::future<std::vector<Borrowing>> getAllBorrowingsAsync();
+    std::future<std::vector<Borrowing>> getCurrentBorrowingsAsync();
+    std::future<std::vector<Borrowing>> getMemberBorrowingsAsync(int memberId);
+    std::future<std::vector<Reservation>> getAllReservationsAsync();
+    std::future<bool> createBorrowingAsync(int bookId, int memberId, int staffId,
+                                           const std::string& dueDate);
+    std::future<bool> returnBookAsync(int borrowingId);
+    
+    // Queues job on the same worker threads; used by the coroutine front end (DBCoroutines.h)
+    void post(std::function<void()> job);
+    
     // Utility
     std::string getLastError() const;
+    LoggerStats getLoggerStats() const;
+    // Blocks until everything logged so far is in library_db.log (and library_db_slow.log)
+    void flushLog();
+    // Size/day limits and retention for library_db.log
+    void setLogRotation(const LogRotationPolicy& policy);
+    StatementCacheStats getStatementCacheStats() const;
+    
+    // Latency percentiles, rows and round trips per operation (e.g. "Get all
+    // books") since startup or the last reset. A call is timed as the caller
+    // sees it, including reconnects and deadlock retries.
+    std::vector<OperationSummary> getOperationStats() const;
+    void resetOperationStats();
+    
+    // Statements at or above the threshold (50 ms by default) are written to
+    // library_db_slow.log with their SQL, bound values, rows and timings
+    void setSlowQueryPolicy(const SlowQueryPolicy& policy);
+    
+    // Calls, errors, rows and total/mean/max time per statement fingerprint
+    // (the SQL with its literals replaced by ?), highest total time first
+    std::vector<QuerySummary> getQueryStats() const;
+    // Writes getQueryStats() to path; false if the file cannot be written (logged)
+    bool exportQueryStats(const std::string& path, QueryStatsFormat format);
+    void resetQueryStats();
+    
+    // Chrome/Perfetto trace of every operation, statement and prepare/execute/
+    // fetch phase until stopTrace(); callers add their own spans with
+    // TraceSpan(db.getTracer(), ...). False if the file cannot be created.
+    bool startTrace(const std::string& path);
+    void stopTrace();
+    Tracer& getTracer() { return tracer; }
+    
+    // Operation, statement, pool, statement cache, write retry, log and
+    // checkout/return metrics in the Prometheus text exposition format
+    std::string getMetricsText() const;
+    // Rewrites path with getMetricsText() every interval, for node_exporter's
+    // textfile collector, until stopMetricsExport(). False if it cannot be written.
+    bool startMetricsExport(const std::string& path,
+                            std::chrono::seconds interval = std::chrono::seconds(15));
+    void stopMetricsExport();
+    bool isExportingMetrics() const { return metrics.isExporting(); }
 };
 
 #endif // DBMANAGER_H
\ No newline at end of file
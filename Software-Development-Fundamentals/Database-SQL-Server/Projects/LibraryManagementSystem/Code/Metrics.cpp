@@ -0,0 +1,250 @@
+// FILE: Metrics.cpp
+#include "Metrics.h"
+#include <filesystem>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+
+static std::atomic<std::uint64_t> nextRegistryId(1);
+
+// The shard this thread last used, so add() skips the registry lock
+static thread_local std::uint64_t cachedRegistry = 0;
+static thread_local void* cachedShard = nullptr;
+
+// ============================================
+// Text exposition format
+// ============================================
+static const char* typeName(MetricType type) {
+    switch (type) {
+        case MetricType::Counter: return "counter";
+        case MetricType::Gauge: return "gauge";
+        case MetricType::Summary: return "summary";
+    }
+    return "untyped";
+}
+
+// HELP text escapes backslash and newline; label values also escape quotes
+static std::string escape(const std::string& text, bool quotes) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        if (c == '\\') escaped += "\\\\";
+        else if (c == '\n') escaped += "\\n";
+        else if (c == '"' && quotes) escaped += "\\\"";
+        else escaped += c;
+    }
+    return escaped;
+}
+
+static std::string seriesName(const std::string& name, const MetricLabels& labels) {
+    if (labels.empty()) return name;
+    std::string text = name + "{";
+    for (std::size_t i = 0; i < labels.size(); ++i) {
+        if (i > 0) text += ",";
+        text += labels[i].first + "=\"" + escape(labels[i].second, true) + "\"";
+    }
+    return text + "}";
+}
+
+void MetricsWriter::family(const std::string& name, const std::string& help, MetricType type) {
+    text += "# HELP " + name + " " + escape(help, false) + "\n";
+    text += "# TYPE " + name + " " + typeName(type) + "\n";
+}
+
+void MetricsWriter::sample(const std::string& name, const MetricLabels& labels, double value) {
+    char number[32];
+    if (std::isnan(value)) std::snprintf(number, sizeof(number), "NaN");
+    else std::snprintf(number, sizeof(number), "%.6f", value);
+    text += seriesName(name, labels) + " " + number + "\n";
+}
+
+void MetricsWriter::sample(const std::string& name, const MetricLabels& labels, std::uint64_t value) {
+    text += seriesName(name, labels) + " " + std::to_string(value) + "\n";
+}
+
+// ============================================
+// Counters
+// ============================================
+void Counter::add(std::uint64_t amount) const {
+    if (!registry) return;
+    std::atomic<std::uint64_t>& value = registry->localShard().values[slot];
+    // This thread is the shard's only writer, so no read-modify-write is needed
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+MetricsRegistry::MetricsRegistry()
+    : id(nextRegistryId.fetch_add(1)), nextSlot(0), exportStopping(false), exporting(false) {}
+
+MetricsRegistry::~MetricsRegistry() {
+    stopExport();
+}
+
+MetricsRegistry::Shard& MetricsRegistry::localShard() {
+    if (cachedRegistry == id) return *static_cast<Shard*>(cachedShard);
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    Shard*& shard = shardsByThread[std::this_thread::get_id()];
+    if (!shard) {
+        shards.push_back(std::unique_ptr<Shard>(new Shard()));
+        shard = shards.back().get();
+    }
+    cachedRegistry = id;
+    cachedShard = shard;
+    return *shard;
+}
+
+Counter MetricsRegistry::counter(const std::string& name, const std::string& help,
+                                 const MetricLabels& labels, double scale) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Family* family = nullptr;
+    for (Family& candidate : families) {
+        if (candidate.name == name) family = &candidate;
+    }
+    if (!family) {
+        families.push_back(Family());
+        family = &families.back();
+        family->name = name;
+        family->help = help;
+        family->scale = scale;
+    }
+    
+    for (const Series& series : family->series) {
+        if (series.labels == labels) return Counter(this, series.slot);
+    }
+    if (nextSlot >= MAX_SERIES) return Counter();
+    
+    Series series;
+    series.labels = labels;
+    series.slot = nextSlot++;
+    family->series.push_back(series);
+    return Counter(this, series.slot);
+}
+
+void MetricsRegistry::addCollector(std::function<void(MetricsWriter&)> collect) {
+    std::lock_guard<std::mutex> lock(mutex);
+    collectors.push_back(std::move(collect));
+}
+
+// ============================================
+// Scrape and export
+// ============================================
+std::string MetricsRegistry::scrape() const {
+    MetricsWriter writer;
+    std::vector<std::function<void(MetricsWriter&)>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Family& family : families) {
+            writer.family(family.name, family.help, MetricType::Counter);
+            for (const Series& series : family.series) {
+                std::uint64_t total = 0;
+                for (const auto& shard : shards) {
+                    total += shard->values[series.slot].load(std::memory_order_relaxed);
+                }
+                if (family.scale == 1.0) writer.sample(family.name, series.labels, total);
+                else writer.sample(family.name, series.labels, static_cast<double>(total) * family.scale);
+            }
+        }
+        pending = collectors;
+    }
+    
+    // Collectors take other locks (the pool's, say), so they run without this one
+    for (const auto& collect : pending) {
+        collect(writer);
+    }
+    return writer.str();
+}
+
+bool MetricsRegistry::writeTextfile(const std::string& path) const {
+    std::string text = scrape();
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        out << text;
+        out.flush();
+        if (!out) return false;
+    }
+    
+    // Replaces an existing file, also on Windows
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+bool MetricsRegistry::startExport(const std::string& path, std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> control(exportControl);
+    if (exporter.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(exportMutex);
+            exportStopping = true;
+        }
+        exportWake.notify_one();
+        exporter.join();
+    }
+    if (!writeTextfile(path)) {
+        exporting.store(false);
+        return false;
+    }
+    
+    exportStopping = false;
+    exporting.store(true);
+    exporter = std::thread([this, path, interval]() {
+        std::unique_lock<std::mutex> lock(exportMutex);
+        while (!exportWake.wait_for(lock, interval, [this]() { return exportStopping; })) {
+            lock.unlock();
+            writeTextfile(path);   // a failed write is retried on the next tick
+            lock.lock();
+        }
+        lock.unlock();
+        writeTextfile(path);
+    });
+    return true;
+}
+
+void MetricsRegistry::stopExport() {
+    std::lock_guard<std::mutex> control(exportControl);
+    if (!exporter.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(exportMutex);
+        exportStopping = true;
+    }
+    exportWake.notify_one();
+    exporter.join();
+    exporting.store(false);
+}
+
+// ============================================
+// StatementMetrics
+// ============================================
+static std::uint64_t toMicros(std::chrono::steady_clock::duration elapsed) {
+    long long micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    return micros > 0 ? static_cast<std::uint64_t>(micros) : 0;
+}
+
+StatementMetrics::StatementMetrics(MetricsRegistry& registry) {
+    statements = registry.counter("library_db_statements_total",
+                                  "Statements sent to the server");
+    errors = registry.counter("library_db_statement_errors_total",
+                              "Statements that failed");
+    rows = registry.counter("library_db_rows_fetched_total",
+                            "Rows fetched from result sets");
+    const char* secondsHelp = "Time spent in each phase of a statement";
+    prepareMicros = registry.counter("library_db_statement_seconds_total", secondsHelp,
+                                     MetricLabels{{"phase", "prepare"}}, 1e-6);
+    executeMicros = registry.counter("library_db_statement_seconds_total", secondsHelp,
+                                     MetricLabels{{"phase", "execute"}}, 1e-6);
+    fetchMicros = registry.counter("library_db_statement_seconds_total", secondsHelp,
+                                   MetricLabels{{"phase", "fetch"}}, 1e-6);
+}
+
+void StatementMetrics::statementFinished(const StatementRecord& record) {
+    statements.add();
+    if (record.failed) errors.add();
+    if (record.rows > 0) rows.add(record.rows);
+    prepareMicros.add(toMicros(record.prepareTime));
+    executeMicros.add(toMicros(record.executeTime));
+    fetchMicros.add(toMicros(record.fetchTime));
+}
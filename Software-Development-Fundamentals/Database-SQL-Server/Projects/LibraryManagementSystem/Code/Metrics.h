@@ -0,0 +1,161 @@
+// FILE: Metrics.h
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "OperationStats.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+enum class MetricType {
+    Counter,
+    Gauge,
+    Summary
+};
+
+// Label name/value pairs of one sample, e.g. {{"operation", "Get all books"}}
+typedef std::vector<std::pair<std::string, std::string>> MetricLabels;
+
+class MetricsRegistry;
+
+// One counter series. Adding touches only the calling thread's shard of the
+// registry: a relaxed load and store, no lock and no shared cache line.
+// A default-constructed counter ignores add().
+class Counter {
+private:
+    friend class MetricsRegistry;
+    
+    MetricsRegistry* registry;
+    std::size_t slot;
+    
+    Counter(MetricsRegistry* owner, std::size_t index) : registry(owner), slot(index) {}
+    
+public:
+    Counter() : registry(nullptr), slot(0) {}
+    
+    void add(std::uint64_t amount = 1) const;
+};
+
+// Builds one scrape in the Prometheus text exposition format (version 0.0.4).
+// Describe a family, then add its samples before starting the next one.
+class MetricsWriter {
+private:
+    std::string text;
+    
+public:
+    void family(const std::string& name, const std::string& help, MetricType type);
+    void sample(const std::string& name, const MetricLabels& labels, double value);
+    void sample(const std::string& name, const MetricLabels& labels, std::uint64_t value);
+    
+    const std::string& str() const { return text; }
+};
+
+// Counters and scrape-time collectors for one DBManager. Each thread that
+// adds to a counter gets its own shard of slots, registered on its first
+// add; a scrape sums the shards. State that already lives elsewhere (pool
+// sizes, logger queue) is read by collectors at scrape time instead of being
+// counted twice. Counters only go up; a scrape may see one shard mid-update.
+class MetricsRegistry {
+private:
+    static const std::size_t MAX_SERIES = 256;
+    
+    struct alignas(64) Shard {
+        std::atomic<std::uint64_t> values[MAX_SERIES];
+        
+        Shard() {
+            for (auto& value : values) value.store(0, std::memory_order_relaxed);
+        }
+    };
+    
+    struct Series {
+        MetricLabels labels;
+        std::size_t slot;
+    };
+    
+    struct Family {
+        std::string name;
+        std::string help;
+        double scale;                 // applied on export, e.g. 1e-6 for microseconds counted as seconds
+        std::vector<Series> series;
+    };
+    
+    const std::uint64_t id;           // tells this registry's shards apart in the per-thread cache
+    
+    mutable std::mutex mutex;         // guards everything below, not the shard values
+    std::vector<Family> families;     // in registration order
+    std::size_t nextSlot;
+    // Shards outlive their threads so counts are never lost; a thread that
+    // reuses an exited thread's id carries on with its shard.
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::unordered_map<std::thread::id, Shard*> shardsByThread;
+    std::vector<std::function<void(MetricsWriter&)>> collectors;
+    
+    // Periodic textfile export
+    std::mutex exportControl;         // serializes startExport/stopExport
+    std::thread exporter;
+    std::mutex exportMutex;           // only for sleeping between writes
+    std::condition_variable exportWake;
+    bool exportStopping;
+    std::atomic<bool> exporting;
+    
+    friend class Counter;
+    Shard& localShard();
+    
+public:
+    MetricsRegistry();
+    ~MetricsRegistry();
+    
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+    
+    // The counter for name and labels, created on first request. Callers keep
+    // the handle; looking it up takes the registry lock. Past MAX_SERIES the
+    // handle does nothing.
+    Counter counter(const std::string& name, const std::string& help,
+                    const MetricLabels& labels = MetricLabels(), double scale = 1.0);
+    
+    // Called on every scrape, after the counters, to write further families
+    void addCollector(std::function<void(MetricsWriter&)> collect);
+    
+    // Every metric in the text exposition format
+    std::string scrape() const;
+    
+    // Replaces path with a fresh scrape via a temporary file and a rename, so a
+    // reader such as node_exporter's textfile collector never sees half a file
+    bool writeTextfile(const std::string& path) const;
+    
+    // Rewrites path every interval on a background thread until stopExport(),
+    // which writes it one last time. False if the first write fails.
+    bool startExport(const std::string& path, std::chrono::milliseconds interval);
+    void stopExport();
+    bool isExporting() const { return exporting.load(); }
+};
+
+// Publishes every statement DBManager runs: how many, how many failed, rows
+// fetched and seconds spent in each phase
+class StatementMetrics : public StatementObserver {
+private:
+    Counter statements;
+    Counter errors;
+    Counter rows;
+    Counter prepareMicros;
+    Counter executeMicros;
+    Counter fetchMicros;
+    
+public:
+    explicit StatementMetrics(MetricsRegistry& registry);
+    
+    bool wantsParameters() const override { return false; }
+    void statementFinished(const StatementRecord& record) override;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,296 @@
+// FILE: OperationStats.cpp
+#include "OperationStats.h"
+#include <cstdio>
+#include <cstring>
+
+// Innermost timer on this thread; timers link outwards through `enclosing`
+static thread_local OperationTimer* currentTimer = nullptr;
+
+// ============================================
+// LatencyHistogram
+// ============================================
+LatencyHistogram::LatencyHistogram() : total(0), sumMicros(0), maxMicros(0) {
+    for (int i = 0; i < BUCKET_COUNT; ++i) counts[i].store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucketOf(std::uint64_t micros) {
+    if (micros < static_cast<std::uint64_t>(EXACT_BUCKETS)) return static_cast<int>(micros);
+    
+    int top = 63;
+    while (!(micros >> top)) --top;               // top >= 5 here
+    int octave = top - 5;
+    if (octave >= OCTAVES) return BUCKET_COUNT - 1;
+    // The four bits after the leading one pick the sub-bucket
+    int sub = static_cast<int>((micros >> (top - 4)) & (SUB_BUCKETS - 1));
+    return EXACT_BUCKETS + octave * SUB_BUCKETS + sub;
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(int bucket) {
+    if (bucket < EXACT_BUCKETS) return static_cast<std::uint64_t>(bucket);
+    
+    int octave = (bucket - EXACT_BUCKETS) / SUB_BUCKETS;
+    int sub = (bucket - EXACT_BUCKETS) % SUB_BUCKETS;
+    int shift = octave + 1;
+    std::uint64_t lower = static_cast<std::uint64_t>(SUB_BUCKETS + sub) << shift;
+    return lower + (std::uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t micros) {
+    counts[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sumMicros.fetch_add(micros, std::memory_order_relaxed);
+    
+    std::uint64_t seen = maxMicros.load(std::memory_order_relaxed);
+    while (micros > seen &&
+           !maxMicros.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+        // seen was reloaded by the failed exchange
+    }
+}
+
+std::uint64_t LatencyHistogram::percentile(double fraction) const {
+    unsigned long long samples = count();
+    if (samples == 0) return 0;
+    
+    unsigned long long rank = static_cast<unsigned long long>(fraction * static_cast<double>(samples) + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > samples) rank = samples;
+    
+    unsigned long long seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // A bucket bound can overshoot the largest sample actually seen
+            std::uint64_t bound = bucketUpperBound(i);
+            return bound < max() ? bound : max();
+        }
+    }
+    return max();
+}
+
+double LatencyHistogram::mean() const {
+    unsigned long long samples = count();
+    if (samples == 0) return 0.0;
+    return static_cast<double>(sumMicros.load(std::memory_order_relaxed)) / static_cast<double>(samples);
+}
+
+void LatencyHistogram::reset() {
+    for (int i = 0; i < BUCKET_COUNT; ++i) counts[i].store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    sumMicros.store(0, std::memory_order_relaxed);
+    maxMicros.store(0, std::memory_order_relaxed);
+}
+
+// ============================================
+// OperationStats
+// ============================================
+OperationStats::Entry& OperationStats::entry(const std::string& operation) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<Entry>& slot = entries[operation];
+    if (!slot) slot.reset(new Entry());
+    return *slot;
+}
+
+void OperationStats::record(const std::string& operation, std::chrono::steady_clock::duration elapsed,
+                            bool succeeded, unsigned long long rows, unsigned long long roundTrips) {
+    // Entries are never erased, so the counters can be updated after the lock is dropped
+    Entry& target = entry(operation);
+    long long micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    target.latency.record(micros > 0 ? static_cast<std::uint64_t>(micros) : 0);
+    if (!succeeded) target.errors.fetch_add(1, std::memory_order_relaxed);
+    target.rows.fetch_add(rows, std::memory_order_relaxed);
+    target.roundTrips.fetch_add(roundTrips, std::memory_order_relaxed);
+}
+
+std::vector<OperationSummary> OperationStats::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<OperationSummary> result;
+    result.reserve(entries.size());
+    for (const auto& item : entries) {
+        const Entry& source = *item.second;
+        OperationSummary& summary = result.emplace_back();
+        summary.operation = item.first;
+        summary.calls = source.latency.count();
+        summary.errors = source.errors.load(std::memory_order_relaxed);
+        summary.rows = source.rows.load(std::memory_order_relaxed);
+        summary.roundTrips = source.roundTrips.load(std::memory_order_relaxed);
+        summary.meanMicros = source.latency.mean();
+        summary.p50Micros = source.latency.percentile(0.50);
+        summary.p90Micros = source.latency.percentile(0.90);
+        summary.p99Micros = source.latency.percentile(0.99);
+        summary.maxMicros = source.latency.max();
+    }
+    return result;
+}
+
+void OperationStats::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& item : entries) {
+        Entry& target = *item.second;
+        target.latency.reset();
+        target.errors.store(0, std::memory_order_relaxed);
+        target.rows.store(0, std::memory_order_relaxed);
+        target.roundTrips.store(0, std::memory_order_relaxed);
+    }
+}
+
+// ============================================
+// StatementObservers
+// ============================================
+bool StatementObservers::wantsParameters() const {
+    for (StatementObserver* observer : observers) {
+        if (observer->wantsParameters()) return true;
+    }
+    return false;
+}
+
+void StatementObservers::statementFinished(const StatementRecord& record) {
+    for (StatementObserver* observer : observers) observer->statementFinished(record);
+}
+
+void StatementObservers::operationFinished(const std::string& operation,
+                                           std::chrono::steady_clock::time_point start,
+                                           std::chrono::steady_clock::duration elapsed, bool succeeded) {
+    for (StatementObserver* observer : observers) {
+        observer->operationFinished(operation, start, elapsed, succeeded);
+    }
+}
+
+// ============================================
+// OperationTimer
+// ============================================
+OperationTimer::OperationTimer(OperationStats& target, const std::string& operationName,
+                               StatementObserver* statementObserver)
+    : stats(target), operation(operationName), observer(statementObserver),
+      start(std::chrono::steady_clock::now()), enclosing(currentTimer),
+      rows(0), roundTrips(0), ok(false), statementOpen(false) {
+    currentTimer = this;
+}
+
+OperationTimer::~OperationTimer() {
+    finishStatement();
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+    stats.record(operation, elapsed, ok, rows, roundTrips);
+    if (observer) observer->operationFinished(operation, start, elapsed, ok);
+    if (enclosing) {
+        enclosing->rows += rows;
+        enclosing->roundTrips += roundTrips;
+    }
+    currentTimer = enclosing;
+}
+
+void OperationTimer::finishStatement() {
+    if (!statementOpen) return;
+    statementOpen = false;
+    observer->statementFinished(statement);
+}
+
+void OperationTimer::countRows(unsigned long long count) {
+    if (!currentTimer) return;
+    currentTimer->rows += count;
+    if (currentTimer->statementOpen) currentTimer->statement.rows += count;
+}
+
+void OperationTimer::countRoundTrip() {
+    if (currentTimer) ++currentTimer->roundTrips;
+}
+
+StatementRecord* OperationTimer::beginStatement(const std::string& sql) {
+    OperationTimer* timer = currentTimer;
+    if (!timer || !timer->observer) return nullptr;
+    timer->finishStatement();
+    
+    // Reuses the previous record's buffers
+    StatementRecord& record = timer->statement;
+    record.operation = &timer->operation;
+    record.sql = sql;
+    record.parameterCount = 0;
+    record.droppedParameters = 0;
+    record.prepareTime = record.executeTime = record.fetchTime = std::chrono::steady_clock::duration(0);
+    record.prepareStarted = record.executeStarted = record.fetchStarted = record.ended =
+        std::chrono::steady_clock::time_point();
+    record.rows = 0;
+    record.failed = false;
+    timer->statementOpen = true;
+    return &record;
+}
+
+StatementRecord* OperationTimer::currentStatement() {
+    OperationTimer* timer = currentTimer;
+    return timer && timer->statementOpen ? &timer->statement : nullptr;
+}
+
+bool OperationTimer::capturingParameters() {
+    OperationTimer* timer = currentTimer;
+    return timer && timer->statementOpen && timer->observer->wantsParameters();
+}
+
+// The next free parameter slot of this thread's statement, or nullptr
+static BoundParameter* nextParameter(StatementRecord* record, short index, BoundParameter::Kind kind) {
+    if (!record) return nullptr;
+    if (record->parameterCount == StatementRecord::MAX_PARAMETERS) {
+        ++record->droppedParameters;
+        return nullptr;
+    }
+    BoundParameter& parameter = record->parameters[record->parameterCount++];
+    parameter.index = index;
+    parameter.kind = kind;
+    return &parameter;
+}
+
+void OperationTimer::noteInteger(short index, long long value) {
+    if (BoundParameter* parameter = nextParameter(currentStatement(), index, BoundParameter::Kind::Integer)) {
+        parameter->integer = value;
+    }
+}
+
+void OperationTimer::noteReal(short index, double value) {
+    if (BoundParameter* parameter = nextParameter(currentStatement(), index, BoundParameter::Kind::Real)) {
+        parameter->real = value;
+    }
+}
+
+void OperationTimer::noteText(short index, const char* value) {
+    if (BoundParameter* parameter = nextParameter(currentStatement(), index, BoundParameter::Kind::Text)) {
+        std::size_t length = 0;
+        while (length < BoundParameter::MAX_TEXT && value[length] != '\0') ++length;
+        std::memcpy(parameter->text, value, length);
+        parameter->textLength = length;
+        parameter->cut = value[length] != '\0';
+    }
+}
+
+void OperationTimer::noteShape(short index, BoundParameter::Kind kind, std::size_t count) {
+    if (BoundParameter* parameter = nextParameter(currentStatement(), index, kind)) {
+        parameter->count = count;
+    }
+}
+
+// ============================================
+// BoundParameter
+// ============================================
+std::string BoundParameter::render() const {
+    switch (kind) {
+        case Kind::Integer:
+            return std::to_string(integer);
+        case Kind::Real: {
+            char number[32];
+            std::snprintf(number, sizeof(number), "%g", real);
+            return number;
+        }
+        case Kind::Text: {
+            std::string quoted = "'";
+            for (std::size_t i = 0; i < textLength; ++i) {
+                if (text[i] == '\'') quoted += '\'';   // doubled, as in a SQL literal
+                quoted += text[i];
+            }
+            return quoted + (cut ? "'..." : "'");
+        }
+        case Kind::Masked:
+            return "***";
+        case Kind::Array:
+            return "[" + std::to_string(count) + " values]";
+        case Kind::Table:
+            return "[table of " + std::to_string(count) + " rows]";
+    }
+    return "?";
+}
@@ -0,0 +1,265 @@
+// FILE: OperationStats.h
+#ifndef OPERATIONSTATS_H
+#define OPERATIONSTATS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include <initializer_list>
+
+// Latency distribution in microseconds with HDR-style buckets: exact below
+// 32 us, then 16 buckets per power of two (within ~6%). Recording is a few
+// relaxed atomic adds, so any number of threads may record at once.
+class LatencyHistogram {
+private:
+    static const int EXACT_BUCKETS = 32;
+    static const int SUB_BUCKETS = 16;
+    static const int OCTAVES = 35;                // up to 2^40 us, about 12 days
+    static const int BUCKET_COUNT = EXACT_BUCKETS + OCTAVES * SUB_BUCKETS;
+    
+    std::atomic<unsigned long long> counts[BUCKET_COUNT];
+    std::atomic<unsigned long long> total;
+    std::atomic<unsigned long long> sumMicros;
+    std::atomic<std::uint64_t> maxMicros;
+    
+    static int bucketOf(std::uint64_t micros);
+    static std::uint64_t bucketUpperBound(int bucket);
+    
+public:
+    LatencyHistogram();
+    
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+    
+    void record(std::uint64_t micros);
+    
+    // Smallest recorded bucket bound covering fraction (0..1) of the samples; 0 if empty
+    std::uint64_t percentile(double fraction) const;
+    unsigned long long count() const { return total.load(std::memory_order_relaxed); }
+    std::uint64_t max() const { return maxMicros.load(std::memory_order_relaxed); }
+    double mean() const;
+    
+    void reset();
+};
+
+struct OperationSummary {
+    std::string operation;           // runRead/runWrite name, e.g. "Get all books"
+    unsigned long long calls;
+    unsigned long long errors;       // calls that returned failure
+    unsigned long long rows;         // rows fetched, all calls together
+    unsigned long long roundTrips;   // statements sent to the server, all calls together
+    double meanMicros;
+    std::uint64_t p50Micros;
+    std::uint64_t p90Micros;
+    std::uint64_t p99Micros;
+    std::uint64_t maxMicros;
+    
+    OperationSummary() : calls(0), errors(0), rows(0), roundTrips(0), meanMicros(0),
+                         p50Micros(0), p90Micros(0), p99Micros(0), maxMicros(0) {}
+};
+
+// Per-operation latency, rows and round trips for one DBManager.
+// Operations are registered on first use and never removed.
+class OperationStats {
+private:
+    struct Entry {
+        LatencyHistogram latency;
+        std::atomic<unsigned long long> errors;
+        std::atomic<unsigned long long> rows;
+        std::atomic<unsigned long long> roundTrips;
+        
+        Entry() : errors(0), rows(0), roundTrips(0) {}
+    };
+    
+    mutable std::mutex mutex;                                // guards the map, not the counters
+    std::map<std::string, std::unique_ptr<Entry>> entries;   // sorted for printing
+    
+    Entry& entry(const std::string& operation);
+    
+public:
+    void record(const std::string& operation, std::chrono::steady_clock::duration elapsed,
+                bool succeeded, unsigned long long rows, unsigned long long roundTrips);
+    
+    // Operations in name order; counters of one operation may be mid-update
+    std::vector<OperationSummary> snapshot() const;
+    void reset();
+};
+
+// A bound value as it was at bind time. Numbers and the first MAX_TEXT
+// characters of text are copied into the record itself, so capturing never
+// allocates; render() formats the value only when a statement is reported.
+struct BoundParameter {
+    static const std::size_t MAX_TEXT = 64;
+    
+    enum class Kind {
+        Integer,
+        Real,
+        Text,
+        Masked,              // personal data, rendered as ***
+        Array,               // count values, one per row of a bulk execute
+        Table                // table-valued parameter of count rows
+    };
+    
+    short index;
+    Kind kind;
+    long long integer;
+    double real;
+    std::size_t count;
+    char text[MAX_TEXT];
+    std::size_t textLength;
+    bool cut;                // the text was longer than MAX_TEXT
+    
+    // e.g. 42, 'O''Brien', ***, [1000 values], [table of 5 rows]
+    std::string render() const;
+};
+
+// One statement as DBManager prepared, bound, executed and fetched it
+struct StatementRecord {
+    static const std::size_t MAX_PARAMETERS = 16;
+    
+    const std::string* operation;    // enclosing operation; valid while the record is reported
+    std::string sql;
+    // Bound values, if an observer wants them; parameters past MAX_PARAMETERS
+    // are only counted in droppedParameters
+    BoundParameter parameters[MAX_PARAMETERS];
+    std::size_t parameterCount;
+    std::size_t droppedParameters;
+    std::chrono::steady_clock::duration prepareTime;
+    std::chrono::steady_clock::duration executeTime;
+    std::chrono::steady_clock::duration fetchTime;       // time inside fetches only
+    // When each phase first began (default-constructed if it never ran) and
+    // when the last one ended; fetchStarted..ended also covers row decoding
+    std::chrono::steady_clock::time_point prepareStarted;
+    std::chrono::steady_clock::time_point executeStarted;
+    std::chrono::steady_clock::time_point fetchStarted;
+    std::chrono::steady_clock::time_point ended;
+    unsigned long long rows;
+    bool failed;
+    
+    StatementRecord() : operation(nullptr), parameterCount(0), droppedParameters(0),
+                        prepareTime(0), executeTime(0), fetchTime(0), rows(0), failed(false) {}
+    
+    std::chrono::steady_clock::duration elapsed() const { return prepareTime + executeTime + fetchTime; }
+};
+
+// Receives each statement once it is complete: when the next statement on
+// the same operation starts, or when the operation ends. Called on the
+// thread that ran the statement, so implementations must be quick.
+class StatementObserver {
+public:
+    virtual ~StatementObserver() {}
+    
+    // Whether bound values should be captured into StatementRecord::parameters
+    virtual bool wantsParameters() const = 0;
+    virtual void statementFinished(const StatementRecord& record) = 0;
+    // After the operation's last statement
+    virtual void operationFinished(const std::string& operation, std::chrono::steady_clock::time_point start,
+                                   std::chrono::steady_clock::duration elapsed, bool succeeded) {
+        (void)operation; (void)start; (void)elapsed; (void)succeeded;
+    }
+};
+
+// Hands each statement to a fixed list of observers, in order
+class StatementObservers : public StatementObserver {
+private:
+    std::vector<StatementObserver*> observers;
+    
+public:
+    StatementObservers(std::initializer_list<StatementObserver*> list) : observers(list) {}
+    
+    bool wantsParameters() const override;
+    void statementFinished(const StatementRecord& record) override;
+    void operationFinished(const std::string& operation, std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::duration elapsed, bool succeeded) override;
+};
+
+// Times one DBManager operation on the calling thread and records it into
+// stats when destroyed. Rows and round trips counted while it is the
+// innermost timer on the thread are attributed to it, and also to any
+// enclosing timer when it ends. With an observer, the statements it runs
+// are recorded one by one as well.
+class OperationTimer {
+private:
+    OperationStats& stats;
+    const std::string& operation;
+    StatementObserver* observer;
+    std::chrono::steady_clock::time_point start;
+    OperationTimer* enclosing;
+    unsigned long long rows;
+    unsigned long long roundTrips;
+    bool ok;
+    
+    StatementRecord statement;
+    bool statementOpen;
+    
+    void finishStatement();
+    
+public:
+    // operation (and observer, if any) must outlive the timer
+    OperationTimer(OperationStats& target, const std::string& operationName,
+                   StatementObserver* statementObserver = nullptr);
+    ~OperationTimer();
+    
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+    
+    // Without this the call is recorded as an error
+    void succeeded() { ok = true; }
+    
+    // No-ops when no operation is being timed on this thread
+    static void countRows(unsigned long long count);
+    static void countRoundTrip();
+    
+    // Reports the previous statement and starts recording sql. Returns the new
+    // record, or nullptr when no observer is watching this thread's operation.
+    static StatementRecord* beginStatement(const std::string& sql);
+    // The statement being recorded on this thread, or nullptr
+    static StatementRecord* currentStatement();
+    // Whether bound values should be passed to the note* calls at all
+    static bool capturingParameters();
+    static void noteInteger(short index, long long value);
+    static void noteReal(short index, double value);
+    static void noteText(short index, const char* value);
+    // Also used for Array and Table, with count as the value or row count
+    static void noteShape(short index, BoundParameter::Kind kind, std::size_t count = 0);
+};
+
+// Adds the time until it goes out of scope to one phase of a statement record,
+// stamps the phase's first start and the record's end, and marks the
+// statement failed if the scope is left by an exception.
+// Does nothing for a null record.
+class StatementPhase {
+private:
+    StatementRecord* record;
+    std::chrono::steady_clock::duration StatementRecord::* phase;
+    std::chrono::steady_clock::time_point start;
+    int exceptions;
+    
+public:
+    StatementPhase(StatementRecord* target, std::chrono::steady_clock::duration StatementRecord::* member,
+                   std::chrono::steady_clock::time_point StatementRecord::* started)
+        : record(target), phase(member),
+          start(target ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()),
+          exceptions(std::uncaught_exceptions()) {
+        if (record && record->*started == std::chrono::steady_clock::time_point()) record->*started = start;
+    }
+    
+    ~StatementPhase() {
+        if (!record) return;
+        record->ended = std::chrono::steady_clock::now();
+        record->*phase += record->ended - start;
+        if (std::uncaught_exceptions() > exceptions) record->failed = true;
+    }
+    
+    StatementPhase(const StatementPhase&) = delete;
+    StatementPhase& operator=(const StatementPhase&) = delete;
+};
+
+#endif // OPERATIONSTATS_H
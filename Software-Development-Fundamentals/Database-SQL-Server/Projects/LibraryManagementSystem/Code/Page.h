@@ -0,0 +1,59 @@
+// FILE: Page.h
+#ifndef PAGE_H
+#define PAGE_H
+
+#include <string>
+#include <vector>
+
+// One screen of a keyset-paginated listing. Pass `next` back to the same
+// get*Page call to continue; it is only meaningful while hasMore is true.
+// A default-constructed cursor starts at the first row.
+template <typename T, typename Cursor>
+struct Page {
+    std::vector<T> items;
+    Cursor next;
+    bool hasMore;
+    
+    Page() : hasMore(false) {}
+};
+
+// Books ordered by Title, BookID
+struct BookCursor {
+    std::string title;
+    int bookId;
+    
+    BookCursor() : bookId(0) {}
+    BookCursor(const std::string& afterTitle, int afterId) : title(afterTitle), bookId(afterId) {}
+    bool atStart() const { return bookId == 0; }
+};
+
+// Members ordered by LastName, FirstName, MemberID
+struct MemberCursor {
+    std::string lastName;
+    std::string firstName;
+    int memberId;
+    
+    MemberCursor() : memberId(0) {}
+    bool atStart() const { return memberId == 0; }
+};
+
+// Borrowings and reservations are listed newest first. The date is kept at
+// full DATETIME2 precision (style 121) so ties on the displayed value
+// cannot skip rows between pages.
+struct BorrowingCursor {
+    std::string borrowDate;
+    int borrowingId;
+    
+    BorrowingCursor() : borrowingId(0) {}
+    bool atStart() const { return borrowingId == 0; }
+};
+
+struct ReservationCursor {
+    std::string reservationDate;
+    int reservationId;
+    
+    ReservationCursor() : reservationId(0) {}
+    bool atStart() const { return reservationId == 0; }
+};
+
+#endif // PAGE_H
@@ -0,0 +1,181 @@
+// FILE: QueryStats.cpp
+#include "QueryStats.h"
+#include "Json.h"
+#include <algorithm>
+#include <cctype>
+
+static bool isWordChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '@' || c == '#' || c == '$';
+}
+
+static std::uint64_t toMicros(std::chrono::steady_clock::duration elapsed) {
+    long long micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    return micros > 0 ? static_cast<std::uint64_t>(micros) : 0;
+}
+
+// ============================================
+// Fingerprints
+// ============================================
+std::string QueryStats::fingerprint(const std::string& sql) {
+    std::string result;
+    result.reserve(sql.size());
+    bool pendingSpace = false;
+    
+    for (std::size_t i = 0; i < sql.size(); ) {
+        char c = sql[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pendingSpace = !result.empty();
+            ++i;
+            continue;
+        }
+        if (pendingSpace) {
+            result += ' ';
+            pendingSpace = false;
+        }
+        
+        bool startsWord = result.empty() || !isWordChar(result.back());
+        bool unicodeLiteral = (c == 'N' || c == 'n') && startsWord &&
+                              i + 1 < sql.size() && sql[i + 1] == '\'';
+        if (c == '\'' || unicodeLiteral) {
+            // Skip to the closing quote; '' inside the literal is an escaped quote
+            i += unicodeLiteral ? 2 : 1;
+            while (i < sql.size()) {
+                if (sql[i] == '\'') {
+                    if (i + 1 < sql.size() && sql[i + 1] == '\'') {
+                        i += 2;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                ++i;
+            }
+            result += '?';
+        } else if (std::isdigit(static_cast<unsigned char>(c)) && startsWord) {
+            // A number, not the digits at the end of an identifier like Col1
+            while (i < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[i])) || sql[i] == '.')) ++i;
+            result += '?';
+        } else {
+            result += c;
+            ++i;
+        }
+    }
+    return result;
+}
+
+// ============================================
+// Recording
+// ============================================
+QueryStats::Entry& QueryStats::entry(const std::string& sql) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto known = byText.find(sql);
+    if (known != byText.end()) return *known->second;
+    
+    std::string key = fingerprint(sql);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        if (entries.size() >= MAX_FINGERPRINTS) key = "(other)";
+        std::unique_ptr<Entry>& slot = entries[key];
+        if (!slot) slot.reset(new Entry());
+        it = entries.find(key);
+    }
+    if (byText.size() < MAX_TEXTS) byText.emplace(sql, it->second.get());
+    return *it->second;
+}
+
+void QueryStats::statementFinished(const StatementRecord& record) {
+    // Entries are never erased, so the counters can be updated after the lock is dropped
+    Entry& target = entry(record.sql);
+    std::uint64_t micros = toMicros(record.elapsed());
+    
+    target.calls.fetch_add(1, std::memory_order_relaxed);
+    if (record.failed) target.errors.fetch_add(1, std::memory_order_relaxed);
+    target.rows.fetch_add(record.rows, std::memory_order_relaxed);
+    target.totalMicros.fetch_add(micros, std::memory_order_relaxed);
+    target.executeMicros.fetch_add(toMicros(record.executeTime), std::memory_order_relaxed);
+    target.fetchMicros.fetch_add(toMicros(record.fetchTime), std::memory_order_relaxed);
+    
+    std::uint64_t seen = target.maxMicros.load(std::memory_order_relaxed);
+    while (micros > seen &&
+           !target.maxMicros.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+        // seen was reloaded by the failed exchange
+    }
+}
+
+std::vector<QuerySummary> QueryStats::snapshot() const {
+    std::vector<QuerySummary> result;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        result.reserve(entries.size());
+        for (const auto& item : entries) {
+            const Entry& source = *item.second;
+            QuerySummary summary;
+            summary.fingerprint = item.first;
+            summary.calls = source.calls.load(std::memory_order_relaxed);
+            if (summary.calls == 0) continue;
+            summary.errors = source.errors.load(std::memory_order_relaxed);
+            summary.rows = source.rows.load(std::memory_order_relaxed);
+            summary.totalMicros = source.totalMicros.load(std::memory_order_relaxed);
+            summary.executeMicros = source.executeMicros.load(std::memory_order_relaxed);
+            summary.fetchMicros = source.fetchMicros.load(std::memory_order_relaxed);
+            summary.maxMicros = source.maxMicros.load(std::memory_order_relaxed);
+            result.push_back(summary);
+        }
+    }
+    
+    std::sort(result.begin(), result.end(), [](const QuerySummary& a, const QuerySummary& b) {
+        return a.totalMicros > b.totalMicros;
+    });
+    return result;
+}
+
+void QueryStats::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& item : entries) {
+        Entry& target = *item.second;
+        target.calls.store(0, std::memory_order_relaxed);
+        target.errors.store(0, std::memory_order_relaxed);
+        target.rows.store(0, std::memory_order_relaxed);
+        target.totalMicros.store(0, std::memory_order_relaxed);
+        target.executeMicros.store(0, std::memory_order_relaxed);
+        target.fetchMicros.store(0, std::memory_order_relaxed);
+        target.maxMicros.store(0, std::memory_order_relaxed);
+    }
+}
+
+// ============================================
+// Export
+// ============================================
+static std::string csvField(const std::string& text) {
+    std::string field = "\"";
+    for (char c : text) {
+        if (c == '"') field += '"';
+        field += c;
+    }
+    return field + "\"";
+}
+
+void QueryStats::writeCsv(std::ostream& out, const std::vector<QuerySummary>& rows) {
+    out << "fingerprint,calls,errors,rows,total_us,mean_us,max_us,execute_us,fetch_us\n";
+    for (const QuerySummary& row : rows) {
+        out << csvField(row.fingerprint) << ',' << row.calls << ',' << row.errors << ','
+            << row.rows << ',' << row.totalMicros << ','
+            << static_cast<std::uint64_t>(row.meanMicros() + 0.5) << ',' << row.maxMicros << ','
+            << row.executeMicros << ',' << row.fetchMicros << '\n';
+    }
+}
+
+void QueryStats::writeJson(std::ostream& out, const std::vector<QuerySummary>& rows) {
+    out << "[\n";
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        const QuerySummary& row = rows[i];
+        out << "  {\"fingerprint\": " << jsonString(row.fingerprint)
+            << ", \"calls\": " << row.calls << ", \"errors\": " << row.errors
+            << ", \"rows\": " << row.rows << ", \"total_us\": " << row.totalMicros
+            << ", \"mean_us\": " << static_cast<std::uint64_t>(row.meanMicros() + 0.5)
+            << ", \"max_us\": " << row.maxMicros << ", \"execute_us\": " << row.executeMicros
+            << ", \"fetch_us\": " << row.fetchMicros << "}"
+            << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
@@ -0,0 +1,81 @@
+// FILE: QueryStats.h
+#ifndef QUERYSTATS_H
+#define QUERYSTATS_H
+
+#include "OperationStats.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+
+enum class QueryStatsFormat {
+    Csv,
+    Json
+};
+
+struct QuerySummary {
+    std::string fingerprint;         // SQL text with literals as ? and whitespace collapsed
+    unsigned long long calls;
+    unsigned long long errors;
+    unsigned long long rows;         // rows fetched
+    std::uint64_t totalMicros;       // prepare + execute + fetch
+    std::uint64_t executeMicros;
+    std::uint64_t fetchMicros;
+    std::uint64_t maxMicros;
+    
+    QuerySummary() : calls(0), errors(0), rows(0), totalMicros(0), executeMicros(0),
+                     fetchMicros(0), maxMicros(0) {}
+    
+    double meanMicros() const { return calls ? static_cast<double>(totalMicros) / static_cast<double>(calls) : 0.0; }
+};
+
+// Cumulative totals for every statement DBManager runs, grouped by
+// fingerprint so that one query shape is one row however its values vary
+// (in the spirit of pg_stat_statements). Each distinct SQL text is
+// normalized once; after that a statement costs one map lookup under a
+// mutex and a few relaxed atomic adds.
+class QueryStats : public StatementObserver {
+private:
+    struct Entry {
+        std::atomic<unsigned long long> calls;
+        std::atomic<unsigned long long> errors;
+        std::atomic<unsigned long long> rows;
+        std::atomic<std::uint64_t> totalMicros;
+        std::atomic<std::uint64_t> executeMicros;
+        std::atomic<std::uint64_t> fetchMicros;
+        std::atomic<std::uint64_t> maxMicros;
+        
+        Entry() : calls(0), errors(0), rows(0), totalMicros(0), executeMicros(0),
+                  fetchMicros(0), maxMicros(0) {}
+    };
+    
+    // Bounds for SQL built with inline literals, which would otherwise grow the maps forever
+    static const std::size_t MAX_TEXTS = 10000;
+    static const std::size_t MAX_FINGERPRINTS = 2000;
+    
+    mutable std::mutex mutex;                                           // guards both maps, not the counters
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries;    // by fingerprint
+    std::unordered_map<std::string, Entry*> byText;                     // raw SQL text -> its entry
+    
+    Entry& entry(const std::string& sql);
+    
+public:
+    // Literals ('text', N'text', numbers) become ?, runs of whitespace one space
+    static std::string fingerprint(const std::string& sql);
+    
+    bool wantsParameters() const override { return false; }
+    void statementFinished(const StatementRecord& record) override;
+    
+    // Highest total time first
+    std::vector<QuerySummary> snapshot() const;
+    void reset();
+    
+    static void writeCsv(std::ostream& out, const std::vector<QuerySummary>& rows);
+    static void writeJson(std::ostream& out, const std::vector<QuerySummary>& rows);
+};
+
+#endif // QUERYSTATS_H
@@ -0,0 +1,247 @@
+// FILE: RowDecodeBench.cpp
+// Allocations-per-row microbenchmark, built as its own program (RowDecodeBench).
+// Runs one fixed query (every book with its category) and decodes the same
+// rows three ways, counting heap allocations with a replaced operator new:
+//
+//   get<T> copies     - the old decoder: a temporary Book per row, every cell
+//                       returned by value with result::get<T>, then push_back
+//   get_ref           - BookMapper::decode into a Book emplaced in the vector
+//   get_ref, reused   - BookMapper::decode into one Book, as forEachBook does
+//
+// Only fetching and decoding are counted, not prepare or execute. Every
+// replaceable operator new is replaced (plain, nothrow and over-aligned, single
+// and array), so no C++ allocation escapes the count. Allocations the ODBC
+// driver makes with malloc are not seen; both variants share them.
+// The query is read-only.
+//
+//     RowDecodeBench "<connection string>" [passes]
+#include "Book.h"
+#include "RowMapper.h"
+#include <nanodbc/nanodbc.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+// ============================================
+// Allocation counting
+// ============================================
+static atomic<bool> counting(false);
+static atomic<unsigned long long> allocations(0);
+static atomic<unsigned long long> allocatedBytes(0);
+
+static void countAllocation(size_t size) {
+    if (counting.load(memory_order_relaxed)) {
+        allocations.fetch_add(1, memory_order_relaxed);
+        allocatedBytes.fetch_add(size, memory_order_relaxed);
+    }
+}
+
+static void* countedAlloc(size_t size) {
+    countAllocation(size);
+    void* block = malloc(size == 0 ? 1 : size);
+    if (!block) throw bad_alloc();
+    return block;
+}
+
+// Over-aligned types (alignas above the default new alignment) come here
+static void* countedAlignedAlloc(size_t size, align_val_t alignment) {
+    countAllocation(size);
+    size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+    void* block = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+    // aligned_alloc wants the size rounded up to a multiple of the alignment
+    size_t rounded = size == 0 ? align : (size + align - 1) / align * align;
+    void* block = aligned_alloc(align, rounded);
+#endif
+    if (!block) throw bad_alloc();
+    return block;
+}
+
+static void alignedFree(void* block) {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* block) noexcept { free(block); }
+void operator delete[](void* block) noexcept { free(block); }
+void operator delete(void* block, size_t) noexcept { free(block); }
+void operator delete[](void* block, size_t) noexcept { free(block); }
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    try { return countedAlloc(size); } catch (const bad_alloc&) { return nullptr; }
+}
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    try { return countedAlloc(size); } catch (const bad_alloc&) { return nullptr; }
+}
+void operator delete(void* block, const nothrow_t&) noexcept { free(block); }
+void operator delete[](void* block, const nothrow_t&) noexcept { free(block); }
+
+void* operator new(size_t size, align_val_t alignment) { return countedAlignedAlloc(size, alignment); }
+void* operator new[](size_t size, align_val_t alignment) { return countedAlignedAlloc(size, alignment); }
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    try { return countedAlignedAlloc(size, alignment); } catch (const bad_alloc&) { return nullptr; }
+}
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    try { return countedAlignedAlloc(size, alignment); } catch (const bad_alloc&) { return nullptr; }
+}
+void operator delete(void* block, align_val_t) noexcept { alignedFree(block); }
+void operator delete[](void* block, align_val_t) noexcept { alignedFree(block); }
+void operator delete(void* block, size_t, align_val_t) noexcept { alignedFree(block); }
+void operator delete[](void* block, size_t, align_val_t) noexcept { alignedFree(block); }
+void operator delete(void* block, align_val_t, const nothrow_t&) noexcept { alignedFree(block); }
+void operator delete[](void* block, align_val_t, const nothrow_t&) noexcept { alignedFree(block); }
+
+// ============================================
+// Decoders
+// ============================================
+enum class Variant {
+    GetCopies,
+    GetRef,
+    GetRefReused
+};
+
+static const char* variantName(Variant variant) {
+    switch (variant) {
+        case Variant::GetCopies: return "get<T> copies (before)";
+        case Variant::GetRef: return "get_ref (after)";
+        case Variant::GetRefReused: return "get_ref, reused Book";
+    }
+    return "";
+}
+
+// The decoder rows went through before BookMapper
+static void readBookRowByCopy(const nanodbc::result& result, Book& book) {
+    book.bookId = result.get<int>(0);
+    book.isbn = result.get<string>(1);
+    book.title = result.get<string>(2);
+    book.author = result.get<string>(3);
+    book.publisher = result.get<string>(4, "");
+    book.publicationYear = result.get<int>(5);
+    book.categoryId = result.get<int>(6);
+    book.categoryName = result.get<string>(7);
+    book.totalCopies = result.get<int>(8);
+    book.availableCopies = result.get<int>(9);
+    book.price = result.get<double>(10);
+    book.shelfLocation = result.get<string>(11, "");
+}
+
+struct PassResult {
+    unsigned long long rows;
+    unsigned long long allocations;
+    unsigned long long bytes;
+    chrono::steady_clock::duration elapsed;
+    
+    PassResult() : rows(0), allocations(0), bytes(0), elapsed(0) {}
+};
+
+static PassResult runPass(nanodbc::statement& stmt, Variant variant, long rowsetSize) {
+    PassResult pass;
+    nanodbc::result result = nanodbc::execute(stmt, rowsetSize);
+    
+    vector<Book> books;
+    Book reused;
+    allocations = 0;
+    allocatedBytes = 0;
+    auto started = chrono::steady_clock::now();
+    counting = true;
+    
+    while (result.next()) {
+        switch (variant) {
+            case Variant::GetCopies: {
+                Book book;
+                readBookRowByCopy(result, book);
+                books.push_back(book);
+                break;
+            }
+            case Variant::GetRef:
+                BookMapper::decode(result, books.emplace_back());
+                break;
+            case Variant::GetRefReused:
+                BookMapper::decode(result, reused);
+                break;
+        }
+        ++pass.rows;
+    }
+    
+    counting = false;
+    pass.elapsed = chrono::steady_clock::now() - started;
+    pass.allocations = allocations.load();
+    pass.bytes = allocatedBytes.load();
+    return pass;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " \"<connection string>\" [passes]\n";
+        return 2;
+    }
+    int passes = argc > 2 ? atoi(argv[2]) : 20;
+    if (passes < 1) passes = 1;
+    const long rowsetSize = 128;   // DBManager's default for list queries
+    
+    try {
+        nanodbc::connection connection(argv[1]);
+        nanodbc::statement stmt(connection);
+        nanodbc::prepare(stmt,
+            "SELECT " + BookMapper::selectList() + " "
+            "FROM Books b "
+            "INNER JOIN Categories c ON b.CategoryID = c.CategoryID "
+            "ORDER BY b.BookID");
+        
+        // One untimed pass so the server has the plan and the pages cached
+        runPass(stmt, Variant::GetRef, rowsetSize);
+        
+        const Variant variants[] = { Variant::GetCopies, Variant::GetRef, Variant::GetRefReused };
+        PassResult totals[3];
+        // Interleaved so drift in server load hits every variant alike
+        for (int p = 0; p < passes; ++p) {
+            for (int v = 0; v < 3; ++v) {
+                PassResult pass = runPass(stmt, variants[v], rowsetSize);
+                totals[v].rows += pass.rows;
+                totals[v].allocations += pass.allocations;
+                totals[v].bytes += pass.bytes;
+                totals[v].elapsed += pass.elapsed;
+            }
+        }
+        
+        if (totals[0].rows == 0) {
+            cerr << "The Books table is empty; load the sample data first\n";
+            return 2;
+        }
+        
+        cout << "Decoding " << totals[0].rows / static_cast<unsigned long long>(passes) << " rows of Books, "
+             << passes << " passes\n\n";
+        cout << left << setw(26) << "Decoder" << right << setw(14) << "allocs/row"
+             << setw(14) << "bytes/row" << setw(14) << "us/row" << "\n";
+        cout << string(68, '-') << "\n";
+        for (int v = 0; v < 3; ++v) {
+            double rows = static_cast<double>(totals[v].rows);
+            double micros = chrono::duration<double, micro>(totals[v].elapsed).count();
+            cout << left << setw(26) << variantName(variants[v]) << right << fixed
+                 << setw(14) << setprecision(2) << static_cast<double>(totals[v].allocations) / rows
+                 << setw(14) << setprecision(1) << static_cast<double>(totals[v].bytes) / rows
+                 << setw(14) << setprecision(3) << micros / rows << "\n";
+        }
+        cout << "\nVector growth is included for the first two; the reused Book has none.\n";
+    } catch (const nanodbc::database_error& e) {
+        cerr << "Database error: " << e.what() << "\n";
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+// FILE: RowMapper.h
+#ifndef ROWMAPPER_H
+#define ROWMAPPER_H
+
+#include <nanodbc/nanodbc.h>
+#include "Book.h"
+#include "Member.h"
+#include "Borrowing.h"
+#include "Reservation.h"
+#include <array>
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// One result column: the SQL expression that produces it and the entity field
+// it decodes into. A column's ordinal is its position in the descriptor, so the
+// SELECT list and the decoder cannot drift apart.
+template <typename Entity, typename Field, bool Nullable>
+struct Column {
+    static_assert(std::is_same<Field, int>::value || std::is_same<Field, double>::value ||
+                  std::is_same<Field, std::string>::value,
+                  "Column fields must be int, double or std::string");
+    
+    const char* expression;
+    Field Entity::* field;
+};
+
+template <typename Entity, typename Field>
+constexpr Column<Entity, Field, false> column(const char* expression, Field Entity::* field) {
+    return Column<Entity, Field, false>{expression, field};
+}
+
+// NULL decodes to a default-constructed value ("" / 0)
+template <typename Entity, typename Field>
+constexpr Column<Entity, Field, true> nullableColumn(const char* expression, Field Entity::* field) {
+    return Column<Entity, Field, true>{expression, field};
+}
+
+namespace detail {
+
+constexpr std::size_t textLength(const char* text) {
+    std::size_t length = 0;
+    while (text[length] != '\0') ++length;
+    return length;
+}
+
+// Length of the descriptor's column expressions joined with ", "
+template <typename Row, std::size_t... I>
+constexpr std::size_t selectListLength(std::index_sequence<I...>) {
+    return ((textLength(std::get<I>(Row::columns).expression) + (I == 0 ? 0 : 2)) + ...);
+}
+
+template <typename Row, std::size_t Length, std::size_t... I>
+constexpr std::array<char, Length + 1> buildSelectText(std::index_sequence<I...>) {
+    std::array<char, Length + 1> text{};
+    std::size_t at = 0;
+    auto append = [&text, &at](const char* part) {
+        for (std::size_t i = 0; part[i] != '\0'; ++i) text[at++] = part[i];
+    };
+    ((append(I == 0 ? "" : ", "), append(std::get<I>(Row::columns).expression)), ...);
+    return text;
+}
+
+} // namespace detail
+
+// Generates the SELECT list and the row decoder for a descriptor (a struct with
+// an Entity typedef and a constexpr `columns` tuple). Decoding expands to one
+// get_ref call per column with the ordinal and type fixed at compile time.
+template <typename Row>
+class RowMapper {
+public:
+    typedef typename Row::Entity Entity;
+    static constexpr std::size_t columnCount = std::tuple_size<decltype(Row::columns)>::value;
+    static_assert(columnCount > 0, "Row descriptor has no columns");
+    
+    static constexpr std::size_t selectLength =
+        detail::selectListLength<Row>(std::make_index_sequence<columnCount>());
+    
+    // Comma-separated column expressions, joined at compile time
+    static constexpr std::array<char, selectLength + 1> selectText =
+        detail::buildSelectText<Row, selectLength>(std::make_index_sequence<columnCount>());
+    
+    // selectText as a string, for building query text with operator+
+    static const std::string& selectList() {
+        static const std::string list(selectText.data(), selectLength);
+        return list;
+    }
+    
+    static void decode(const nanodbc::result& result, Entity& entity) {
+        decodeColumns(result, entity, std::make_index_sequence<columnCount>());
+    }
+    
+private:
+    template <std::size_t... I>
+    static void decodeColumns(const nanodbc::result& result, Entity& entity, std::index_sequence<I...>) {
+        (decodeColumn(result, static_cast<short>(I), std::get<I>(Row::columns), entity), ...);
+    }
+    
+    template <typename Field>
+    static void decodeColumn(const nanodbc::result& result, short ordinal,
+                             const Column<Entity, Field, false>& col, Entity& entity) {
+        result.get_ref(ordinal, entity.*(col.field));
+    }
+    
+    template <typename Field>
+    static void decodeColumn(const nanodbc::result& result, short ordinal,
+                             const Column<Entity, Field, true>& col, Entity& entity) {
+        static const Field fallback = Field();
+        result.get_ref(ordinal, fallback, entity.*(col.field));
+    }
+};
+
+// Expects FROM Books b INNER JOIN Categories c ON b.CategoryID = c.CategoryID
+struct BookRow {
+    typedef Book Entity;
+    static constexpr auto columns = std::make_tuple(
+        column("b.BookID", &Book::bookId),
+        column("b.ISBN", &Book::isbn),
+        column("b.Title", &Book::title),
+        column("b.Author", &Book::author),
+        nullableColumn("b.Publisher", &Book::publisher),
+        column("b.PublicationYear", &Book::publicationYear),
+        column("b.CategoryID", &Book::categoryId),
+        column("c.CategoryName", &Book::categoryName),
+        column("b.TotalCopies", &Book::totalCopies),
+        column("b.AvailableCopies", &Book::availableCopies),
+        column("b.Price", &Book::price),
+        nullableColumn("b.ShelfLocation", &Book::shelfLocation));
+};
+
+// Expects FROM Members
+struct MemberRow {
+    typedef Member Entity;
+    static constexpr auto columns = std::make_tuple(
+        column("MemberID", &Member::memberId),
+        column("FirstName", &Member::firstName),
+        column("LastName", &Member::lastName),
+        column("Email", &Member::email),
+        nullableColumn("Phone", &Member::phone),
+        nullableColumn("Address", &Member::address),
+        column("CONVERT(VARCHAR, MembershipDate, 23) AS MembershipDate", &Member::membershipDate),
+        column("MembershipStatus", &Member::membershipStatus));
+};
+
+// Expects FROM Borrowings br INNER JOIN Books b ... INNER JOIN Members m ...
+struct BorrowingRow {
+    typedef Borrowing Entity;
+    static constexpr auto columns = std::make_tuple(
+        column("br.BorrowingID", &Borrowing::borrowingId),
+        column("br.BookID", &Borrowing::bookId),
+        column("b.Title", &Borrowing::bookTitle),
+        column("br.MemberID", &Borrowing::memberId),
+        column("m.FirstName + ' ' + m.LastName AS MemberName", &Borrowing::memberName),
+        column("CONVERT(VARCHAR, br.BorrowDate, 120) AS BorrowDate", &Borrowing::borrowDate),
+        column("CONVERT(VARCHAR, br.DueDate, 120) AS DueDate", &Borrowing::dueDate),
+        nullableColumn("CONVERT(VARCHAR, br.ReturnDate, 120) AS ReturnDate", &Borrowing::returnDate),
+        column("br.Status", &Borrowing::status));
+};
+
+// Expects FROM CurrentBorrowings (the view); only the fields the desk screen shows
+struct CurrentBorrowingRow {
+    typedef Borrowing Entity;
+    static constexpr auto columns = std::make_tuple(
+        column("BorrowingID", &Borrowing::borrowingId),
+        column("MemberName", &Borrowing::memberName),
+        column("BookTitle", &Borrowing::bookTitle),
+        column("CONVERT(VARCHAR, BorrowDate, 120) AS BorrowDate", &Borrowing::borrowDate),
+        column("CONVERT(VARCHAR, DueDate, 120) AS DueDate", &Borrowing::dueDate),
+        column("Status", &Borrowing::status));
+};
+
+// Expects FROM Reservations r INNER JOIN Books b ... INNER JOIN Members m ...
+struct ReservationRow {
+    typedef Reservation Entity;
+    static constexpr auto columns = std::make_tuple(
+        column("r.ReservationID", &Reservation::reservationId),
+        column("r.BookID", &Reservation::bookId),
+        column("b.Title", &Reservation::bookTitle),
+        column("r.MemberID", &Reservation::memberId),
+        column("m.FirstName + ' ' + m.LastName AS MemberName", &Reservation::memberName),
+        column("CONVERT(VARCHAR, r.ReservationDate, 120) AS ReservationDate", &Reservation::reservationDate),
+        nullableColumn("CONVERT(VARCHAR, r.ExpiryDate, 120) AS ExpiryDate", &Reservation::expiryDate),
+        column("r.Status", &Reservation::status));
+};
+
+typedef RowMapper<BookRow> BookMapper;
+typedef RowMapper<MemberRow> MemberMapper;
+typedef RowMapper<BorrowingRow> BorrowingMapper;
+typedef RowMapper<CurrentBorrowingRow> CurrentBorrowingMapper;
+typedef RowMapper<ReservationRow> ReservationMapper;
+
+#endif // ROWMAPPER_H
@@ -13,6 +13,15 @@ GO
 CREATE DATABASE LibraryDB;
 GO
 
+-- Readers see the last committed row version instead of blocking behind
+-- open borrow/return transactions (DBManager runs reads concurrently)
+ALTER DATABASE LibraryDB SET READ_COMMITTED_SNAPSHOT ON;
+GO
+
+-- Lets a DBManager TransactionScope ask for IsolationLevel::Snapshot
+ALTER DATABASE LibraryDB SET ALLOW_SNAPSHOT_ISOLATION ON;
+GO
+
 USE LibraryDB;
 GO
 
@@ -156,6 +165,12 @@ CREATE INDEX IDX_Borrowings_Status ON Borrowings(Status);
 CREATE INDEX IDX_Members_Email ON Members(Email);
 CREATE INDEX IDX_Reservations_MemberID ON Reservations(MemberID);
 CREATE INDEX IDX_Reservations_BookID ON Reservations(BookID);
+
+-- Keyset pagination (DBManager::get*Page) seeks on the listing sort order
+CREATE INDEX IDX_Books_Title ON Books(Title, BookID);
+CREATE INDEX IDX_Members_Name ON Members(LastName, FirstName, MemberID);
+CREATE INDEX IDX_Borrowings_BorrowDate ON Borrowings(BorrowDate DESC, BorrowingID DESC);
+CREATE INDEX IDX_Reservations_Date ON Reservations(ReservationDate DESC, ReservationID DESC);
 GO
 
 -- =============================================
@@ -322,6 +337,343 @@ BEGIN
 END;
 GO
 
+-- =============================================
+-- STORED PROCEDURE: CheckoutBook
+-- =============================================
+-- One round trip per checkout. Result codes:
+--   0 = checked out, 1 = no copies available, 2 = member not active,
+--   3 = member not found, 4 = book not found
+-- Joins the caller's transaction through a savepoint when one is open.
+CREATE PROCEDURE CheckoutBook
+    @BookID INT,
+    @MemberID INT,
+    @StaffID INT,
+    @DueDate DATETIME2
+AS
+BEGIN
+    SET NOCOUNT ON;
+    
+    DECLARE @Result INT;
+    DECLARE @BorrowingID INT = NULL;
+    DECLARE @MembershipStatus NVARCHAR(20);
+    DECLARE @StartedTran BIT = 0;
+    
+    IF @@TRANCOUNT = 0
+    BEGIN
+        BEGIN TRANSACTION;
+        SET @StartedTran = 1;
+    END
+    ELSE
+        SAVE TRANSACTION CheckoutBook;
+    
+    BEGIN TRY
+        SELECT @MembershipStatus = MembershipStatus
+        FROM Members WHERE MemberID = @MemberID;
+        
+        IF @MembershipStatus IS NULL
+            SET @Result = 3;
+        ELSE IF @MembershipStatus <> 'Active'
+            SET @Result = 2;
+        ELSE
+        BEGIN
+            -- The guarded decrement is the availability check; no copy, no row
+            UPDATE Books
+            SET AvailableCopies = AvailableCopies - 1, UpdatedAt = GETDATE()
+            WHERE BookID = @BookID AND AvailableCopies > 0;
+            
+            IF @@ROWCOUNT = 0
+                SET @Result = CASE WHEN EXISTS (SELECT 1 FROM Books WHERE BookID = @BookID)
+                                   THEN 1 ELSE 4 END;
+            ELSE
+            BEGIN
+                INSERT INTO Borrowings (BookID, MemberID, StaffID, DueDate)
+                VALUES (@BookID, @MemberID, @StaffID, @DueDate);
+                
+                SET @BorrowingID = SCOPE_IDENTITY();
+                SET @Result = 0;
+            END
+        END
+        
+        IF @StartedTran = 1
+            COMMIT TRANSACTION;
+    END TRY
+    BEGIN CATCH
+        IF @StartedTran = 1
+            ROLLBACK TRANSACTION;
+        ELSE IF XACT_STATE() = 1
+            ROLLBACK TRANSACTION CheckoutBook;
+        THROW;
+    END CATCH
+    
+    SELECT @Result AS Result, @BorrowingID AS BorrowingID;
+END;
+GO
+
+-- =============================================
+-- STORED PROCEDURE: ReturnBook
+-- =============================================
+-- One round trip per return. Marks the borrowing returned, puts the copy
+-- back and fulfils the oldest Pending reservation for the book, if any.
+-- Result codes: 0 = returned, 1 = borrowing not found, 2 = already returned
+-- Joins the caller's transaction through a savepoint when one is open.
+CREATE PROCEDURE ReturnBook
+    @BorrowingID INT
+AS
+BEGIN
+    SET NOCOUNT ON;
+    
+    DECLARE @Result INT;
+    DECLARE @BookID INT = NULL;
+    DECLARE @ReservationID INT = NULL;
+    DECLARE @StartedTran BIT = 0;
+    
+    IF @@TRANCOUNT = 0
+    BEGIN
+        BEGIN TRANSACTION;
+        SET @StartedTran = 1;
+    END
+    ELSE
+        SAVE TRANSACTION ReturnBook;
+    
+    BEGIN TRY
+        -- Guarded so two desks returning the same loan cannot both add a copy back
+        UPDATE Borrowings
+        SET ReturnDate = GETDATE(), Status = 'Returned', @BookID = BookID
+        WHERE BorrowingID = @BorrowingID AND Status <> 'Returned';
+        
+        IF @@ROWCOUNT = 0
+            SET @Result = CASE WHEN EXISTS (SELECT 1 FROM Borrowings WHERE BorrowingID = @BorrowingID)
+                               THEN 2 ELSE 1 END;
+        ELSE
+        BEGIN
+            UPDATE Books
+            SET AvailableCopies = AvailableCopies + 1, UpdatedAt = GETDATE()
+            WHERE BookID = @BookID;
+            
+            WITH NextReservation AS (
+                SELECT TOP (1) ReservationID, Status
+                FROM Reservations WITH (UPDLOCK)
+                WHERE BookID = @BookID AND Status = 'Pending'
+                ORDER BY ReservationDate, ReservationID
+            )
+            UPDATE NextReservation
+            SET Status = 'Fulfilled', @ReservationID = ReservationID;
+            
+            SET @Result = 0;
+        END
+        
+        IF @StartedTran = 1
+            COMMIT TRANSACTION;
+    END TRY
+    BEGIN CATCH
+        IF @StartedTran = 1
+            ROLLBACK TRANSACTION;
+        ELSE IF XACT_STATE() = 1
+            ROLLBACK TRANSACTION ReturnBook;
+        THROW;
+    END CATCH
+    
+    SELECT @Result AS Result, @BookID AS BookID, @ReservationID AS FulfilledReservationID;
+END;
+GO
+
+-- =============================================
+-- TYPE: BorrowingIdList (table-valued parameter)
+-- =============================================
+CREATE TYPE BorrowingIdList AS TABLE (
+    BorrowingID INT NOT NULL PRIMARY KEY
+);
+GO
+
+-- =============================================
+-- STORED PROCEDURE: ReturnBooks
+-- =============================================
+-- Set-based ReturnBook for a whole drop-box bin in one round trip and one
+-- transaction. Returns one row per input BorrowingID with the same result
+-- codes as ReturnBook. When several copies of a title come back, each goes
+-- to the next-oldest Pending reservation for it.
+CREATE PROCEDURE ReturnBooks
+    @Borrowings BorrowingIdList READONLY
+AS
+BEGIN
+    SET NOCOUNT ON;
+    
+    DECLARE @Returned TABLE (BorrowingID INT PRIMARY KEY, BookID INT NOT NULL);
+    DECLARE @Fulfilled TABLE (ReservationID INT PRIMARY KEY, BookID INT NOT NULL, Seq INT NOT NULL);
+    DECLARE @StartedTran BIT = 0;
+    
+    IF @@TRANCOUNT = 0
+    BEGIN
+        BEGIN TRANSACTION;
+        SET @StartedTran = 1;
+    END
+    ELSE
+        SAVE TRANSACTION ReturnBooks;
+    
+    BEGIN TRY
+        UPDATE br
+        SET ReturnDate = GETDATE(), Status = 'Returned'
+        OUTPUT inserted.BorrowingID, inserted.BookID INTO @Returned
+        FROM Borrowings br
+        INNER JOIN @Borrowings ids ON ids.BorrowingID = br.BorrowingID
+        WHERE br.Status <> 'Returned';
+        
+        UPDATE b
+        SET AvailableCopies = b.AvailableCopies + r.Copies, UpdatedAt = GETDATE()
+        FROM Books b
+        INNER JOIN (SELECT BookID, COUNT(*) AS Copies FROM @Returned GROUP BY BookID) r
+            ON r.BookID = b.BookID;
+        
+        INSERT INTO @Fulfilled (ReservationID, BookID, Seq)
+        SELECT ranked.ReservationID, ranked.BookID, ranked.Seq
+        FROM (
+            SELECT res.ReservationID, res.BookID,
+                   ROW_NUMBER() OVER (PARTITION BY res.BookID
+                                      ORDER BY res.ReservationDate, res.ReservationID) AS Seq
+            FROM Reservations res WITH (UPDLOCK)
+            WHERE res.Status = 'Pending'
+              AND res.BookID IN (SELECT BookID FROM @Returned)
+        ) ranked
+        INNER JOIN (SELECT BookID, COUNT(*) AS Copies FROM @Returned GROUP BY BookID) c
+            ON c.BookID = ranked.BookID
+        WHERE ranked.Seq <= c.Copies;
+        
+        UPDATE res
+        SET Status = 'Fulfilled'
+        FROM Reservations res
+        INNER JOIN @Fulfilled f ON f.ReservationID = res.ReservationID;
+        
+        IF @StartedTran = 1
+            COMMIT TRANSACTION;
+    END TRY
+    BEGIN CATCH
+        IF @StartedTran = 1
+            ROLLBACK TRANSACTION;
+        ELSE IF XACT_STATE() = 1
+            ROLLBACK TRANSACTION ReturnBooks;
+        THROW;
+    END CATCH
+    
+    -- The n-th returned copy of a title is paired with its n-th fulfilled reservation
+    SELECT ids.BorrowingID,
+           CASE WHEN r.BorrowingID IS NOT NULL THEN 0
+                WHEN br.BorrowingID IS NOT NULL THEN 2
+                ELSE 1 END AS Result,
+           COALESCE(r.BookID, br.BookID) AS BookID,
+           f.ReservationID AS FulfilledReservationID
+    FROM @Borrowings ids
+    LEFT JOIN (
+        SELECT BorrowingID, BookID,
+               ROW_NUMBER() OVER (PARTITION BY BookID ORDER BY BorrowingID) AS Seq
+        FROM @Returned
+    ) r ON r.BorrowingID = ids.BorrowingID
+    LEFT JOIN Borrowings br ON br.BorrowingID = ids.BorrowingID
+    LEFT JOIN @Fulfilled f ON f.BookID = r.BookID AND f.Seq = r.Seq
+    ORDER BY ids.BorrowingID;
+END;
+GO
+
+-- =============================================
+-- TYPE: BookIdList (table-valued parameter)
+-- =============================================
+-- Position keeps the caller's order and allows the same title twice
+CREATE TYPE BookIdList AS TABLE (
+    Position INT NOT NULL PRIMARY KEY,
+    BookID INT NOT NULL
+);
+GO
+
+-- =============================================
+-- STORED PROCEDURE: CheckoutBooks
+-- =============================================
+-- Checks out a member's stack of books in one round trip and one
+-- transaction, validating the member once. Returns one row per Position
+-- with CheckoutBook's result codes, plus 5 = not checked out because
+-- another book failed (only when @AllOrNothing = 1).
+CREATE PROCEDURE CheckoutBooks
+    @MemberID INT,
+    @StaffID INT,
+    @DueDate DATETIME2,
+    @Books BookIdList READONLY,
+    @AllOrNothing BIT = 1
+AS
+BEGIN
+    SET NOCOUNT ON;
+    
+    DECLARE @Plan TABLE (Position INT PRIMARY KEY, BookID INT NOT NULL, Result INT NOT NULL);
+    DECLARE @Created TABLE (Position INT PRIMARY KEY, BorrowingID INT NOT NULL);
+    DECLARE @MembershipStatus NVARCHAR(20);
+    DECLARE @StartedTran BIT = 0;
+    
+    IF @@TRANCOUNT = 0
+    BEGIN
+        BEGIN TRANSACTION;
+        SET @StartedTran = 1;
+    END
+    ELSE
+        SAVE TRANSACTION CheckoutBooks;
+    
+    BEGIN TRY
+        SELECT @MembershipStatus = MembershipStatus
+        FROM Members WHERE MemberID = @MemberID;
+        
+        IF @MembershipStatus IS NULL OR @MembershipStatus <> 'Active'
+            INSERT INTO @Plan (Position, BookID, Result)
+            SELECT Position, BookID, CASE WHEN @MembershipStatus IS NULL THEN 3 ELSE 2 END
+            FROM @Books;
+        ELSE
+        BEGIN
+            -- UPDLOCK holds the book rows until commit, so the k-th request
+            -- for a title is granted only while k <= AvailableCopies
+            INSERT INTO @Plan (Position, BookID, Result)
+            SELECT req.Position, req.BookID,
+                   CASE WHEN b.BookID IS NULL THEN 4
+                        WHEN req.Seq <= b.AvailableCopies THEN 0
+                        ELSE 1 END
+            FROM (
+                SELECT Position, BookID,
+                       ROW_NUMBER() OVER (PARTITION BY BookID ORDER BY Position) AS Seq
+                FROM @Books
+            ) req
+            LEFT JOIN Books b WITH (UPDLOCK) ON b.BookID = req.BookID;
+            
+            IF @AllOrNothing = 1 AND EXISTS (SELECT 1 FROM @Plan WHERE Result <> 0)
+                UPDATE @Plan SET Result = 5 WHERE Result = 0;
+            
+            UPDATE b
+            SET AvailableCopies = b.AvailableCopies - g.Copies, UpdatedAt = GETDATE()
+            FROM Books b
+            INNER JOIN (SELECT BookID, COUNT(*) AS Copies FROM @Plan WHERE Result = 0 GROUP BY BookID) g
+                ON g.BookID = b.BookID;
+            
+            -- MERGE rather than INSERT so OUTPUT can pair each new BorrowingID with its Position
+            MERGE Borrowings AS target
+            USING (SELECT Position, BookID FROM @Plan WHERE Result = 0) AS src
+            ON 1 = 0
+            WHEN NOT MATCHED THEN
+                INSERT (BookID, MemberID, StaffID, DueDate)
+                VALUES (src.BookID, @MemberID, @StaffID, @DueDate)
+            OUTPUT src.Position, inserted.BorrowingID INTO @Created;
+        END
+        
+        IF @StartedTran = 1
+            COMMIT TRANSACTION;
+    END TRY
+    BEGIN CATCH
+        IF @StartedTran = 1
+            ROLLBACK TRANSACTION;
+        ELSE IF XACT_STATE() = 1
+            ROLLBACK TRANSACTION CheckoutBooks;
+        THROW;
+    END CATCH
+    
+    SELECT p.Position, p.Result, c.BorrowingID
+    FROM @Plan p
+    LEFT JOIN @Created c ON c.Position = p.Position
+    ORDER BY p.Position;
+END;
+GO
+
 -- =============================================
 -- SAMPLE DATA
 -- =============================================
@@ -0,0 +1,60 @@
+// FILE: SlowQueryLog.cpp
+#include "SlowQueryLog.h"
+#include <sstream>
+#include <iomanip>
+
+static double toMillis(std::chrono::steady_clock::duration elapsed) {
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+SlowQueryLog::SlowQueryLog(const std::string& logPath, const SlowQueryPolicy& policy)
+    : path(logPath), enabled(false), thresholdMicros(0), logParameters(false), slowCount(0) {
+    setPolicy(policy);
+}
+
+void SlowQueryLog::setPolicy(const SlowQueryPolicy& policy) {
+    thresholdMicros.store(std::chrono::duration_cast<std::chrono::microseconds>(policy.threshold).count());
+    logParameters.store(policy.logParameters);
+    enabled.store(policy.enabled);
+}
+
+AsyncLogger& SlowQueryLog::file() {
+    std::call_once(opened, [this]() { logger.reset(new AsyncLogger(path)); });
+    return *logger;
+}
+
+void SlowQueryLog::flush() {
+    if (slowCount.load() > 0) file().flush();
+}
+
+bool SlowQueryLog::wantsParameters() const {
+    return enabled.load(std::memory_order_relaxed) && logParameters.load(std::memory_order_relaxed);
+}
+
+void SlowQueryLog::statementFinished(const StatementRecord& record) {
+    if (!enabled.load(std::memory_order_relaxed)) return;
+    long long micros = std::chrono::duration_cast<std::chrono::microseconds>(record.elapsed()).count();
+    if (micros < thresholdMicros.load(std::memory_order_relaxed)) return;
+    
+    // Past this point the statement was slow anyway, so formatting here costs little
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1)
+         << "Slow query " << toMillis(record.elapsed()) << " ms in "
+         << (record.operation ? *record.operation : std::string("(no operation)"))
+         << ": prepare " << toMillis(record.prepareTime)
+         << " ms, execute " << toMillis(record.executeTime)
+         << " ms, fetch " << toMillis(record.fetchTime)
+         << " ms, " << record.rows << " rows";
+    if (record.failed) line << ", failed";
+    line << " | SQL: " << record.sql;
+    if (record.parameterCount > 0) {
+        line << " | Parameters:";
+        for (std::size_t i = 0; i < record.parameterCount; ++i) {
+            line << " " << record.parameters[i].index << "=" << record.parameters[i].render();
+        }
+        if (record.droppedParameters > 0) line << " (+" << record.droppedParameters << " more)";
+    }
+    
+    slowCount.fetch_add(1, std::memory_order_relaxed);
+    file().write(LogLevel::Warning, line.str());
+}
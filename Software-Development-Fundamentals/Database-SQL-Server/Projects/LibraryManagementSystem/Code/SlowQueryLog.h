@@ -0,0 +1,55 @@
+// FILE: SlowQueryLog.h
+#ifndef SLOWQUERYLOG_H
+#define SLOWQUERYLOG_H
+
+#include "OperationStats.h"
+#include "AsyncLogger.h"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+struct SlowQueryPolicy {
+    bool enabled;
+    std::chrono::milliseconds threshold;   // statements taking at least this long are logged
+    bool logParameters;                    // bound values; masked ones (email, phone) show as ***
+    
+    SlowQueryPolicy() : enabled(true), threshold(50), logParameters(true) {}
+};
+
+// Writes one line per slow statement to its own file: operation, total time
+// split into prepare/execute/fetch, rows fetched, SQL text and bound values.
+// Bound values are captured raw into the statement record (see BoundParameter)
+// and, like the rest of the line, only formatted for statements over the
+// threshold. The line is handed to an AsyncLogger, so the calling thread
+// never waits on the disk. The file is created on the first slow statement.
+class SlowQueryLog : public StatementObserver {
+private:
+    std::string path;
+    std::atomic<bool> enabled;
+    std::atomic<long long> thresholdMicros;
+    std::atomic<bool> logParameters;
+    std::atomic<unsigned long long> slowCount;
+    
+    std::unique_ptr<AsyncLogger> logger;
+    std::once_flag opened;
+    
+    AsyncLogger& file();
+    
+public:
+    explicit SlowQueryLog(const std::string& logPath, const SlowQueryPolicy& policy = SlowQueryPolicy());
+    
+    SlowQueryLog(const SlowQueryLog&) = delete;
+    SlowQueryLog& operator=(const SlowQueryLog&) = delete;
+    
+    void setPolicy(const SlowQueryPolicy& policy);
+    unsigned long long count() const { return slowCount.load(std::memory_order_relaxed); }
+    // Blocks until every slow statement reported so far is on disk
+    void flush();
+    
+    bool wantsParameters() const override;
+    void statementFinished(const StatementRecord& record) override;
+};
+
+#endif // SLOWQUERYLOG_H
@@ -0,0 +1,51 @@
+// FILE: StatementCache.cpp
+#include "StatementCache.h"
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+
+nanodbc::statement& StatementCache::get(nanodbc::connection& conn, const std::string& query) {
+    // A single-row lookup or a page read that stopped early leaves its cursor
+    // open, and the next statement on the connection would fail as busy
+    closeCursor();
+    
+    auto it = statements.find(query);
+    if (it != statements.end()) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        it->second.reset_parameters();
+        current = &it->second;
+        return it->second;
+    }
+    
+    // Prepare before inserting so a failed prepare leaves no broken entry behind
+    nanodbc::statement stmt(conn);
+    nanodbc::prepare(stmt, query);
+    misses.fetch_add(1, std::memory_order_relaxed);
+    nanodbc::statement& cached = statements.emplace(query, std::move(stmt)).first->second;
+    size.store(statements.size(), std::memory_order_relaxed);
+    current = &cached;
+    return cached;
+}
+
+void StatementCache::closeCursor() {
+    if (!current) return;
+    // SQL_CLOSE keeps the handle and its prepared plan, unlike nanodbc's close().
+    // It succeeds when no cursor is open; on a dead link the error does not matter.
+    SQLFreeStmt(static_cast<SQLHSTMT>(current->native_statement_handle()), SQL_CLOSE);
+    current = nullptr;
+}
+
+void StatementCache::clear() {
+    current = nullptr;
+    statements.clear();
+    size.store(0, std::memory_order_relaxed);
+}
+
+StatementCacheStats StatementCache::stats() const {
+    StatementCacheStats result;
+    result.hits = hits.load(std::memory_order_relaxed);
+    result.misses = misses.load(std::memory_order_relaxed);
+    result.size = size.load(std::memory_order_relaxed);
+    return result;
+}
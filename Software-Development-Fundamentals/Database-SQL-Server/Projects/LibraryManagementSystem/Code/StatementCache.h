@@ -0,0 +1,51 @@
+// FILE: StatementCache.h
+#ifndef STATEMENTCACHE_H
+#define STATEMENTCACHE_H
+
+#include <nanodbc/nanodbc.h>
+#include <string>
+#include <unordered_map>
+#include <atomic>
+#include <cstddef>
+
+struct StatementCacheStats {
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t size;
+    
+    StatementCacheStats() : hits(0), misses(0), size(0) {}
+};
+
+// Prepared statements of a single connection, keyed by query text.
+// A hit skips SQLPrepare entirely; the caller only re-binds and executes.
+// The connection has no MARS, so it serves one result set at a time: a
+// statement's cursor is closed before another statement is handed out, and
+// closeCursor() frees the connection once an operation is done with it.
+// Only the thread holding the connection may call get() and closeCursor();
+// stats() may be read from any thread.
+class StatementCache {
+private:
+    std::unordered_map<std::string, nanodbc::statement> statements;
+    std::atomic<std::size_t> hits;
+    std::atomic<std::size_t> misses;
+    std::atomic<std::size_t> size;
+    nanodbc::statement* current;             // last statement handed out; its cursor may be open
+
+public:
+    StatementCache() : hits(0), misses(0), size(0), current(nullptr) {}
+    
+    // Returns a prepared statement for query, preparing it on first use.
+    // Closes the cursor of the statement handed out before it first.
+    nanodbc::statement& get(nanodbc::connection& conn, const std::string& query);
+    
+    // Closes the cursor of the last statement handed out and discards its
+    // pending results; the statement stays prepared
+    void closeCursor();
+    
+    // Drops every statement; must run before the owning connection goes away
+    void clear();
+    
+    StatementCacheStats stats() const;
+};
+
+#endif // STATEMENTCACHE_H
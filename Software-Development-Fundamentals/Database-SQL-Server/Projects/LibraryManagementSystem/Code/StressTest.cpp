@@ -0,0 +1,263 @@
+// FILE: StressTest.cpp
+// Concurrency stress harness, built as its own program (LibraryStress).
+// N threads share one DBManager and mix listings, lookups, checkouts and
+// returns, some of them racing to return the same loan. Afterwards every
+// book's AvailableCopies must be back where it started, no loan may have
+// been returned twice, and no listing may have shown a copy count outside
+// 0..TotalCopies.
+//
+// It checks books out and returns them, so run it against a test copy of
+// LibraryDB that nothing else is writing to.
+//
+//     LibraryStress "<connection string>" [threads] [iterations per thread]
+#include "DBManager.h"
+#include "Book.h"
+#include "Member.h"
+#include "Staff.h"
+#include "Page.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+
+using namespace std;
+
+// State shared by the worker threads
+struct StressState {
+    mutex lock;                     // guards everything below
+    vector<int> openLoans;          // borrowings this run checked out and nobody has returned yet
+    set<int> returnedLoans;         // borrowings this run returned
+    vector<int> refusedReturns;     // AlreadyReturned answers, checked against returnedLoans at the end
+    map<int, long> netCheckouts;    // BookID -> checkouts minus returns by this run
+    
+    atomic<long> reads;
+    atomic<long> checkouts;
+    atomic<long> returns;
+    atomic<long> refusals;          // NoCopiesAvailable and other refusals the procedures report
+    atomic<long> errors;            // calls that came back Failed or empty
+    atomic<long> violations;
+    
+    StressState() : reads(0), checkouts(0), returns(0), refusals(0), errors(0), violations(0) {}
+};
+
+static void violation(StressState& state, const string& message) {
+    lock_guard<mutex> guard(state.lock);
+    ++state.violations;
+    cerr << "✗ VIOLATION: " << message << "\n";
+}
+
+static void checkCopies(StressState& state, const vector<Book>& books) {
+    for (const Book& book : books) {
+        if (book.availableCopies < 0 || book.availableCopies > book.totalCopies) {
+            violation(state, "BookID " + to_string(book.bookId) + " lists " +
+                      to_string(book.availableCopies) + " of " + to_string(book.totalCopies) + " copies available");
+        }
+    }
+}
+
+static string dueDateInTwoWeeks() {
+    time_t due = time(nullptr) + 14 * 24 * 3600;
+    tm local;
+#ifdef _WIN32
+    localtime_s(&local, &due);
+#else
+    localtime_r(&due, &local);
+#endif
+    char text[16];
+    strftime(text, sizeof(text), "%Y-%m-%d", &local);
+    return text;
+}
+
+static void runWorker(DBManager& db, StressState& state, int seed, int iterations,
+                      const vector<int>& bookIds, const vector<int>& memberIds, int staffId,
+                      const string& dueDate) {
+    mt19937 rng(seed);
+    auto pick = [&rng](const vector<int>& ids) { return ids[static_cast<size_t>(rng()) % ids.size()]; };
+    
+    for (int i = 0; i < iterations; ++i) {
+        unsigned dice = static_cast<unsigned>(rng() % 10);
+        
+        if (dice < 4) {
+            switch (static_cast<unsigned>(rng() % 5)) {
+                case 0: checkCopies(state, db.getAllBooks()); break;
+                case 1: checkCopies(state, db.searchBooksByTitle("a")); break;
+                case 2: checkCopies(state, db.getBooksPage(BookCursor(), 20).items); break;
+                case 3: checkCopies(state, db.getAllBooksAsync().get()); break;
+                default: db.getMemberById(pick(memberIds)); break;
+            }
+            ++state.reads;
+        } else if (dice < 7) {
+            int bookId = pick(bookIds);
+            CheckoutResult result = db.checkoutBook(bookId, pick(memberIds), staffId, dueDate);
+            if (result.ok()) {
+                lock_guard<mutex> guard(state.lock);
+                state.openLoans.push_back(result.borrowingId);
+                ++state.netCheckouts[bookId];
+                ++state.checkouts;
+            } else if (result.status == CheckoutStatus::Failed) {
+                ++state.errors;
+            } else {
+                ++state.refusals;
+            }
+        } else {
+            // The loan stays listed until it is returned, so other threads may race for it
+            int borrowingId = 0;
+            {
+                lock_guard<mutex> guard(state.lock);
+                if (state.openLoans.empty()) continue;
+                borrowingId = state.openLoans[static_cast<size_t>(rng()) % state.openLoans.size()];
+            }
+            
+            ReturnResult result = db.returnBorrowing(borrowingId);
+            if (result.ok()) {
+                bool twice = false;
+                {
+                    lock_guard<mutex> guard(state.lock);
+                    twice = !state.returnedLoans.insert(borrowingId).second;
+                    vector<int>& open = state.openLoans;
+                    for (size_t k = 0; k < open.size(); ++k) {
+                        if (open[k] == borrowingId) {
+                            open[k] = open.back();
+                            open.pop_back();
+                            break;
+                        }
+                    }
+                    --state.netCheckouts[result.bookId];
+                    ++state.returns;
+                }
+                if (twice) violation(state, "BorrowingID " + to_string(borrowingId) + " was returned twice");
+            } else if (result.status == ReturnStatus::AlreadyReturned) {
+                lock_guard<mutex> guard(state.lock);
+                state.refusedReturns.push_back(borrowingId);
+                ++state.refusals;
+            } else {
+                ++state.errors;
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " \"<connection string>\" [threads] [iterations per thread]\n";
+        return 2;
+    }
+    int threadCount = argc > 2 ? atoi(argv[2]) : 8;
+    int iterations = argc > 3 ? atoi(argv[3]) : 200;
+    if (threadCount < 1) threadCount = 1;
+    if (iterations < 1) iterations = 1;
+    
+    DBManager db;
+    PoolConfig poolConfig;
+    poolConfig.maxSize = static_cast<size_t>(threadCount);
+    db.setPoolConfig(poolConfig);
+    if (!db.connect(argv[1])) {
+        cerr << "Failed to connect; see library_db.log\n";
+        return 2;
+    }
+    
+    vector<Book> startBooks = db.getAllBooks();
+    map<int, int> startAvailable;
+    vector<int> bookIds;
+    for (const Book& book : startBooks) {
+        startAvailable[book.bookId] = book.availableCopies;
+        if (book.totalCopies > 0) bookIds.push_back(book.bookId);
+    }
+    vector<int> memberIds;
+    for (const Member& member : db.getAllMembers()) {
+        if (member.isActive()) memberIds.push_back(member.memberId);
+    }
+    vector<Staff> staff = db.getAllStaff();
+    if (bookIds.empty() || memberIds.empty() || staff.empty()) {
+        cerr << "Need at least one book with copies, one active member and one staff member\n";
+        return 2;
+    }
+    
+    cout << "Stressing with " << threadCount << " threads x " << iterations << " iterations over "
+         << bookIds.size() << " books and " << memberIds.size() << " members...\n";
+    
+    StressState state;
+    string dueDate = dueDateInTwoWeeks();
+    auto started = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < threadCount; ++t) {
+        workers.emplace_back(runWorker, ref(db), ref(state), 1000 + t, iterations,
+                             cref(bookIds), cref(memberIds), staff.front().staffId, cref(dueDate));
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    
+    // Hand back whatever is still out, then every count must match the start
+    for (int borrowingId : state.openLoans) {
+        ReturnResult result = db.returnBorrowing(borrowingId);
+        if (!result.ok()) {
+            violation(state, "cleanup could not return BorrowingID " + to_string(borrowingId) +
+                      ": " + returnStatusMessage(result.status));
+            continue;
+        }
+        if (!state.returnedLoans.insert(borrowingId).second) {
+            violation(state, "BorrowingID " + to_string(borrowingId) + " was returned twice");
+        }
+        --state.netCheckouts[result.bookId];
+    }
+    
+    for (int borrowingId : state.refusedReturns) {
+        if (state.returnedLoans.count(borrowingId) == 0) {
+            violation(state, "BorrowingID " + to_string(borrowingId) +
+                      " was reported already returned, but no return succeeded");
+        }
+    }
+    for (const auto& book : state.netCheckouts) {
+        if (book.second != 0) {
+            violation(state, "BookID " + to_string(book.first) + " has " + to_string(book.second) +
+                      " loans from this run unaccounted for");
+        }
+    }
+    
+    vector<Book> endBooks = db.getAllBooks();
+    checkCopies(state, endBooks);
+    if (endBooks.size() != startBooks.size()) {
+        violation(state, "book count changed from " + to_string(startBooks.size()) +
+                  " to " + to_string(endBooks.size()));
+    }
+    for (const Book& book : endBooks) {
+        auto it = startAvailable.find(book.bookId);
+        if (it != startAvailable.end() && it->second != book.availableCopies) {
+            violation(state, "BookID " + to_string(book.bookId) + " has " + to_string(book.availableCopies) +
+                      " copies available, " + to_string(it->second) + " before the run");
+        }
+    }
+    
+    cout << "Reads: " << state.reads << ", checkouts: " << state.checkouts
+         << ", returns: " << state.returns << ", refusals: " << state.refusals
+         << ", errors: " << state.errors << " in " << seconds << " s\n";
+    WriteRetryStats retries = db.getWriteRetryStats();
+    cout << "Deadlock retries: " << retries.retries << ", given up: " << retries.giveUps << "\n";
+    
+    if (state.violations > 0) {
+        cout << "✗ " << state.violations << " invariant violations (details above)\n";
+        return 1;
+    }
+    // Invariants that held over a run with no writes, or one that hit database
+    // errors, say nothing about the concurrency they are meant to check
+    if (state.checkouts == 0) {
+        cout << "✗ No checkout succeeded, so the run exercised no writes; check the data has copies available\n";
+        return 1;
+    }
+    if (state.errors > 0) {
+        cout << "✗ " << state.errors << " calls came back Failed or empty (see library_db.log)\n";
+        return 1;
+    }
+    cout << "✓ All invariants held\n";
+    return 0;
+}
@@ -0,0 +1,147 @@
+// FILE: Tracer.cpp
+#include "Tracer.h"
+#include "Json.h"
+#include "WorkQueue.h"
+#include <cstdio>
+
+// Buffered events are written once they pass this size
+static const std::size_t WRITE_BLOCK = 64 * 1024;
+// Statement spans are named after the start of their SQL; the full text is in args
+static const std::size_t SPAN_NAME_LENGTH = 60;
+
+// Small sequential ids read better in the trace viewer than hashed thread ids
+static std::atomic<int> nextThreadId(1);
+static thread_local int traceThreadId = 0;
+
+static int currentThreadId() {
+    if (traceThreadId == 0) traceThreadId = nextThreadId.fetch_add(1);
+    return traceThreadId;
+}
+
+// Trace timestamps are microseconds, fractional for sub-microsecond phases
+static std::string micros(std::chrono::steady_clock::duration elapsed) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.3f",
+                  std::chrono::duration<double, std::micro>(elapsed).count());
+    return text;
+}
+
+Tracer::Tracer() : active(false), firstEvent(true) {}
+
+Tracer::~Tracer() {
+    stop();
+}
+
+bool Tracer::start(const std::string& tracePath) {
+    stop();
+    std::lock_guard<std::mutex> controlLock(control);
+    file.open(tracePath.c_str(), std::ios::out | std::ios::trunc);
+    if (!file.is_open()) return false;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    writer.reset(new WorkQueue(1));
+    pending = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    firstEvent = true;
+    origin = std::chrono::steady_clock::now();
+    active.store(true);
+    return true;
+}
+
+void Tracer::stop() {
+    std::lock_guard<std::mutex> controlLock(control);
+    std::unique_ptr<WorkQueue> draining;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!active.load()) return;
+        active.store(false);
+        pending += "\n]}\n";
+        handOffPending();
+        draining = std::move(writer);
+    }
+    // Writes every block handed off so far, in order, then joins the thread
+    draining.reset();
+    file.close();
+}
+
+// Called with mutex held. Posting under the lock keeps blocks in order; the
+// write itself happens on the writer thread.
+void Tracer::handOffPending() {
+    std::string block;
+    block.swap(pending);
+    pending.reserve(WRITE_BLOCK + WRITE_BLOCK / 4);
+    writer->post([this, block]() {
+        file.write(block.data(), static_cast<std::streamsize>(block.size()));
+    });
+}
+
+void Tracer::emit(const char* category, const std::string& name,
+                  std::chrono::steady_clock::time_point start, std::chrono::steady_clock::duration length,
+                  const std::string& args) {
+    int thread = currentThreadId();
+    std::lock_guard<std::mutex> lock(mutex);
+    // Spans that began before the trace started would have negative timestamps
+    if (!active.load() || start < origin) return;
+    
+    if (!firstEvent) pending += ",\n";
+    firstEvent = false;
+    pending += "{\"name\": " + jsonString(name) + ", \"cat\": \"" + category +
+               "\", \"ph\": \"X\", \"ts\": " + micros(start - origin) +
+               ", \"dur\": " + micros(length) + ", \"pid\": 1, \"tid\": " + std::to_string(thread);
+    if (!args.empty()) pending += ", \"args\": {" + args + "}";
+    pending += "}";
+    if (pending.size() >= WRITE_BLOCK) handOffPending();
+}
+
+void Tracer::span(const std::string& name, std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end) {
+    if (!isActive()) return;
+    emit("user", name, start, end - start, "");
+}
+
+void Tracer::operationFinished(const std::string& operation, std::chrono::steady_clock::time_point start,
+                               std::chrono::steady_clock::duration elapsed, bool succeeded) {
+    if (!isActive()) return;
+    emit("db", operation, start, elapsed, succeeded ? "" : "\"failed\": true");
+}
+
+void Tracer::statementFinished(const StatementRecord& record) {
+    if (!isActive()) return;
+    const std::chrono::steady_clock::time_point unset;
+    
+    std::string name = record.sql.size() > SPAN_NAME_LENGTH ? record.sql.substr(0, SPAN_NAME_LENGTH) + "..."
+                                                            : record.sql;
+    std::string args = "\"sql\": " + jsonString(record.sql) + ", \"rows\": " + std::to_string(record.rows);
+    if (record.failed) args += ", \"failed\": true";
+    if (record.prepareStarted != unset && record.ended != unset) {
+        emit("statement", name, record.prepareStarted, record.ended - record.prepareStarted, args);
+    }
+    
+    if (record.prepareStarted != unset) {
+        emit("phase", "prepare", record.prepareStarted, record.prepareTime, "");
+    }
+    if (record.executeStarted != unset) {
+        emit("phase", "execute", record.executeStarted, record.executeTime, "");
+    }
+    if (record.fetchStarted != unset) {
+        // Wall time from the first fetch to the last; busy_us is the time spent inside fetches
+        emit("phase", "fetch", record.fetchStarted, record.ended - record.fetchStarted,
+             "\"rows\": " + std::to_string(record.rows) + ", \"busy_us\": " + micros(record.fetchTime));
+    }
+}
+
+// ============================================
+// TraceSpan
+// ============================================
+TraceSpan::TraceSpan(Tracer& target, const std::string& spanName)
+    : tracer(target), open(target.isActive()) {
+    if (open) {
+        name = spanName;
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+void TraceSpan::end() {
+    if (!open) return;
+    open = false;
+    tracer.span(name, start, std::chrono::steady_clock::now());
+}
@@ -0,0 +1,85 @@
+// FILE: Tracer.h
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "OperationStats.h"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+
+class WorkQueue;
+
+// Writes spans as Chrome trace events (open the file in chrome://tracing or
+// ui.perfetto.dev). While a trace is running it records the spans opened
+// with TraceSpan, every DBManager operation, each statement it ran and that
+// statement's prepare, execute and fetch phases. Spans on one thread nest by
+// time, so a desk operation shows its round trips as a waterfall.
+// Events are buffered; each full block is handed to a writer thread, so the
+// thread that recorded the event never waits on the disk. Nothing is
+// recorded while no trace is running.
+class Tracer : public StatementObserver {
+private:
+    std::atomic<bool> active;
+    std::mutex control;                              // serializes start/stop
+    std::ofstream file;                              // used only by writer's thread while tracing
+    std::mutex mutex;                                // guards everything below
+    std::string pending;                             // formatted events not yet handed off
+    bool firstEvent;
+    std::chrono::steady_clock::time_point origin;    // ts 0 of the trace
+    std::unique_ptr<WorkQueue> writer;               // one thread writing the handed-off blocks
+    
+    void emit(const char* category, const std::string& name,
+              std::chrono::steady_clock::time_point start, std::chrono::steady_clock::duration length,
+              const std::string& args);
+    void handOffPending();
+    
+public:
+    Tracer();
+    ~Tracer();
+    
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+    
+    // Starts a new trace file, ending any running trace first. False if it cannot be created.
+    bool start(const std::string& tracePath);
+    // Completes and closes the file
+    void stop();
+    bool isActive() const { return active.load(std::memory_order_relaxed); }
+    
+    // A span from caller code; see TraceSpan
+    void span(const std::string& name, std::chrono::steady_clock::time_point start,
+              std::chrono::steady_clock::time_point end);
+    
+    bool wantsParameters() const override { return false; }
+    void statementFinished(const StatementRecord& record) override;
+    void operationFinished(const std::string& operation, std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::duration elapsed, bool succeeded) override;
+};
+
+// Records the time from construction to end() (or destruction) as one span.
+// Costs nothing beyond a flag check when no trace is running.
+//
+//     TraceSpan span(db.getTracer(), "returnBook");
+//     ReturnResult result = db.returnBorrowing(id);
+class TraceSpan {
+private:
+    Tracer& tracer;
+    std::string name;
+    std::chrono::steady_clock::time_point start;
+    bool open;
+    
+public:
+    TraceSpan(Tracer& target, const std::string& spanName);
+    ~TraceSpan() { end(); }
+    
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+    
+    // Ends the span early, e.g. before waiting on user input; later calls do nothing
+    void end();
+};
+
+#endif // TRACER_H
@@ -0,0 +1,231 @@
+// FILE: TransactionScope.cpp
+#include "TransactionScope.h"
+#include "DBManager.h"
+#include "OperationStats.h"
+#include <cctype>
+
+// Top of this thread's scope stack; scopes link downwards through `below`
+static thread_local TransactionScope* topScope = nullptr;
+
+static const char* isolationSql(IsolationLevel level) {
+    switch (level) {
+        case IsolationLevel::ReadUncommitted: return "SET TRANSACTION ISOLATION LEVEL READ UNCOMMITTED";
+        case IsolationLevel::RepeatableRead: return "SET TRANSACTION ISOLATION LEVEL REPEATABLE READ";
+        case IsolationLevel::Snapshot: return "SET TRANSACTION ISOLATION LEVEL SNAPSHOT";
+        case IsolationLevel::Serializable: return "SET TRANSACTION ISOLATION LEVEL SERIALIZABLE";
+        case IsolationLevel::ReadCommitted:
+        case IsolationLevel::Default: break;
+    }
+    return "SET TRANSACTION ISOLATION LEVEL READ COMMITTED";
+}
+
+// Savepoint names are spliced into the statement text, so keep them to identifiers
+static bool validSavepointName(const std::string& name) {
+    if (name.empty() || name.size() > 32) return false;
+    for (char c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') return false;
+    }
+    return true;
+}
+
+bool saveTransaction(nanodbc::connection& conn, const std::string& name) {
+    OperationTimer::countRoundTrip();
+    nanodbc::result result = nanodbc::execute(conn,
+        "IF @@TRANCOUNT > 0 SAVE TRANSACTION " + name + "; SELECT @@TRANCOUNT");
+    return result.next() && result.get<int>(0) > 0;
+}
+
+void rollbackTransactionTo(nanodbc::connection& conn, const std::string& name, bool saved) {
+    OperationTimer::countRoundTrip();
+    nanodbc::execute(conn, saved ? "ROLLBACK TRANSACTION " + name
+                                 : std::string("IF @@TRANCOUNT > 0 ROLLBACK TRANSACTION"));
+}
+
+// ============================================
+// TransactionScope
+// ============================================
+TransactionScope::TransactionScope(DBManager& manager, IsolationLevel level)
+    : db(manager), outer(current(&manager)), below(topScope),
+      isolation(outer ? IsolationLevel::Default : level), failed(false), finished(false) {
+    if (outer) {
+        // Joined: one more reference on the outer transaction, same connection
+        if (outer->active()) {
+            transaction.reset(new nanodbc::transaction(lease().connection()));
+        }
+    } else {
+        ownLease = db.acquireConnection();
+        if (ownLease) {
+            try {
+                // Must precede the first statement of the transaction
+                if (isolation != IsolationLevel::Default) {
+                    nanodbc::execute(ownLease.connection(), isolationSql(isolation));
+                }
+                // Switches the connection to manual commit; no BEGIN is sent
+                transaction.reset(new nanodbc::transaction(ownLease.connection()));
+            } catch (const nanodbc::database_error& e) {
+                db.logError(std::string("Begin transaction failed: ") + e.what());
+                ownLease.invalidate();
+                ownLease.release();
+            }
+        }
+    }
+    
+    // Registered even without a connection, so calls meant for the transaction
+    // fail instead of quietly committing one by one
+    if (!transaction) markFailed();
+    topScope = this;
+}
+
+TransactionScope::~TransactionScope() {
+    if (!finished) rollback();
+    unregister();
+}
+
+TransactionScope& TransactionScope::root() {
+    TransactionScope* scope = this;
+    while (scope->outer) scope = scope->outer;
+    return *scope;
+}
+
+const TransactionScope& TransactionScope::root() const {
+    const TransactionScope* scope = this;
+    while (scope->outer) scope = scope->outer;
+    return *scope;
+}
+
+void TransactionScope::unregister() {
+    // Scopes are normally destroyed in reverse order, but do not rely on it
+    for (TransactionScope** link = &topScope; *link; link = &(*link)->below) {
+        if (*link == this) {
+            *link = below;
+            break;
+        }
+    }
+}
+
+TransactionScope* TransactionScope::current(const DBManager* manager) {
+    for (TransactionScope* scope = topScope; scope; scope = scope->below) {
+        if (&scope->db == manager && !scope->finished) return scope;
+    }
+    return nullptr;
+}
+
+bool TransactionScope::active() const {
+    const TransactionScope& top = root();
+    return !finished && transaction && !top.finished && top.ownLease;
+}
+
+bool TransactionScope::hasFailed() const {
+    return failed || root().failed;
+}
+
+void TransactionScope::markFailed() {
+    failed = true;
+    root().failed = true;
+}
+
+ConnectionLease& TransactionScope::lease() {
+    return root().ownLease;
+}
+
+void TransactionScope::end() {
+    if (!outer) {
+        // Joined scopes still open must drop their reference before the lease goes back
+        for (TransactionScope* scope = topScope; scope; scope = scope->below) {
+            if (scope != this && !scope->finished && &scope->root() == this) {
+                scope->transaction.reset();
+                scope->finished = true;
+            }
+        }
+    }
+    // An uncommitted nanodbc::transaction rolls back here and autocommit is restored
+    transaction.reset();
+    if (!outer && ownLease) {
+        if (isolation != IsolationLevel::Default) {
+            // The level outlives the transaction; the next lease must not inherit it
+            try {
+                nanodbc::execute(ownLease.connection(), isolationSql(IsolationLevel::Default));
+            } catch (const nanodbc::database_error&) {
+                ownLease.invalidate();
+            }
+        }
+        ownLease.release();
+    }
+    finished = true;
+    unregister();
+}
+
+bool TransactionScope::commit() {
+    if (finished) return false;
+    if (!transaction || hasFailed()) {
+        rollback();
+        return false;
+    }
+    
+    try {
+        // Joined scopes only drop their reference; the outermost one ends the transaction
+        transaction->commit();
+    } catch (const nanodbc::database_error& e) {
+        db.logError(std::string("Commit failed: ") + e.what());
+        markFailed();
+        end();
+        return false;
+    }
+    end();
+    return true;
+}
+
+void TransactionScope::rollback() {
+    if (finished) return;
+    if (transaction) transaction->rollback();
+    markFailed();
+    end();
+}
+
+bool TransactionScope::savepoint(const std::string& name) {
+    if (!validSavepointName(name)) {
+        db.logError("Invalid savepoint name: " + name);
+        return false;
+    }
+    if (!active()) return false;
+    
+    try {
+        Savepoint mark;
+        mark.name = name;
+        mark.saved = saveTransaction(lease().connection(), name);
+        mark.failedBefore = hasFailed();
+        root().savepoints.push_back(mark);
+        return true;
+    } catch (const nanodbc::database_error& e) {
+        db.logError(std::string("Savepoint failed: ") + e.what());
+        markFailed();
+        return false;
+    }
+}
+
+bool TransactionScope::rollbackTo(const std::string& name) {
+    if (!active()) return false;
+    std::vector<Savepoint>& marks = root().savepoints;
+    std::vector<Savepoint>::reverse_iterator it = marks.rbegin();
+    while (it != marks.rend() && it->name != name) ++it;
+    if (it == marks.rend()) {
+        db.logError("Unknown savepoint: " + name);
+        return false;
+    }
+    
+    try {
+        // Fails if a deadlock already took the transaction (and the savepoint) away
+        rollbackTransactionTo(lease().connection(), name, it->saved);
+    } catch (const nanodbc::database_error& e) {
+        db.logError(std::string("Rollback to savepoint failed: ") + e.what());
+        markFailed();
+        return false;
+    }
+    
+    // Later savepoints are gone; this one stays usable
+    bool failedBefore = it->failedBefore;
+    marks.erase(it.base(), marks.end());
+    failed = failedBefore;
+    root().failed = failedBefore;
+    return true;
+}
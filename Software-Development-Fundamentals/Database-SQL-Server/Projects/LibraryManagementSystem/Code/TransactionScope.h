@@ -0,0 +1,103 @@
+// FILE: TransactionScope.h
+#ifndef TRANSACTIONSCOPE_H
+#define TRANSACTIONSCOPE_H
+
+#include <nanodbc/nanodbc.h>
+#include "ConnectionPool.h"
+#include <string>
+#include <memory>
+#include <vector>
+
+class DBManager;
+
+enum class IsolationLevel {
+    Default,                 // the database's (READ COMMITTED, row-versioned here)
+    ReadUncommitted,
+    ReadCommitted,
+    RepeatableRead,
+    Snapshot,
+    Serializable
+};
+
+// One transaction spanning several DBManager calls. While a scope is alive,
+// every DBManager operation made on the same thread runs on the scope's
+// connection and joins its transaction instead of committing on its own.
+// That includes the streaming forEachBook/forEachBorrowing, so they read at
+// the scope's isolation level (a Snapshot scope streams from its snapshot).
+// testConnection() is the exception: it pings a pooled connection of its own.
+// The transaction is opened and ended by the driver (nanodbc::transaction)
+// rather than with BEGIN/COMMIT statements. Destroying an uncommitted scope
+// rolls back.
+//
+//     TransactionScope tx(db);
+//     db.checkoutBook(...);
+//     db.updateMemberStatus(...);
+//     if (!tx.commit()) { ... nothing was applied ... }
+//
+// A scope created while another is alive on the same thread joins it: its
+// commit() is a no-op and its failure or rollback dooms the outer one.
+// Operations inside a scope are not retried (WriteRetryPolicy); a deadlock
+// fails the scope and the caller reruns the whole unit. The *Async calls run
+// on worker threads and do not join.
+class TransactionScope {
+private:
+    struct Savepoint {
+        std::string name;
+        bool saved;          // false if taken before the transaction's first statement
+        bool failedBefore;   // failure state to restore on rollbackTo
+    };
+    
+    DBManager& db;
+    ConnectionLease ownLease;                   // empty when joined to an outer scope
+    std::unique_ptr<nanodbc::transaction> transaction;
+    std::vector<Savepoint> savepoints;          // kept on the outermost scope
+    TransactionScope* outer;                    // enclosing scope for the same DBManager
+    TransactionScope* below;                    // previous scope on this thread's stack
+    IsolationLevel isolation;
+    bool failed;
+    bool finished;
+    
+    TransactionScope& root();
+    const TransactionScope& root() const;
+    void end();
+    void unregister();
+    
+public:
+    explicit TransactionScope(DBManager& manager, IsolationLevel level = IsolationLevel::Default);
+    ~TransactionScope();
+    
+    TransactionScope(const TransactionScope&) = delete;
+    TransactionScope& operator=(const TransactionScope&) = delete;
+    
+    // False if no connection could be leased (already logged) or the scope has ended
+    bool active() const;
+    // An operation inside the scope failed; commit() will roll back instead
+    bool hasFailed() const;
+    
+    // Commits, or rolls back if any operation failed. Returns true if committed.
+    bool commit();
+    void rollback();
+    
+    // Partial rollback within the transaction. Names are letters, digits and
+    // '_' (at most 32). rollbackTo() also clears a failure recorded after the
+    // savepoint, unless the server already discarded the transaction.
+    bool savepoint(const std::string& name);
+    bool rollbackTo(const std::string& name);
+    
+    ConnectionLease& lease();
+    
+    // Innermost live scope for db on the calling thread, or nullptr
+    static TransactionScope* current(const DBManager* manager);
+    
+    // Used by DBManager when an operation inside the scope throws
+    void markFailed();
+};
+
+// SAVE TRANSACTION for code driving a nanodbc::transaction directly. SQL Server
+// opens a manual-commit transaction at its first statement and SAVE does not
+// count, so before that there is nothing to save: returns false, and rolling
+// back to that mark rolls back the (still empty) transaction instead.
+bool saveTransaction(nanodbc::connection& conn, const std::string& name);
+void rollbackTransactionTo(nanodbc::connection& conn, const std::string& name, bool saved);
+
+#endif // TRANSACTIONSCOPE_H
@@ -0,0 +1,49 @@
+// FILE: WorkQueue.cpp
+#include "WorkQueue.h"
+#include <utility>
+
+WorkQueue::WorkQueue(std::size_t threadCount) : stopping(false) {
+    if (threadCount == 0) threadCount = 1;
+    threads.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&WorkQueue::run, this);
+    }
+}
+
+WorkQueue::~WorkQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkQueue::post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    wakeup.notify_one();
+}
+
+std::size_t WorkQueue::pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size();
+}
+
+void WorkQueue::run() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;   // stopping and drained
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
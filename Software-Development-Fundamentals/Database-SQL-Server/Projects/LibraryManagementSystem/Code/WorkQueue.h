@@ -0,0 +1,39 @@
+// FILE: WorkQueue.h
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+// Fixed set of worker threads draining a FIFO of jobs
+class WorkQueue {
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;
+    bool stopping;
+    
+    void run();
+
+public:
+    explicit WorkQueue(std::size_t threadCount);
+    
+    // Finishes every queued job, then joins the workers
+    ~WorkQueue();
+    
+    WorkQueue(const WorkQueue&) = delete;
+    WorkQueue& operator=(const WorkQueue&) = delete;
+    
+    // Jobs must not throw; wrap fallible work in a std::packaged_task
+    void post(std::function<void()> job);
+    std::size_t pending() const;
+    std::size_t size() const { return threads.size(); }
+};
+
+#endif // WORKQUEUE_H
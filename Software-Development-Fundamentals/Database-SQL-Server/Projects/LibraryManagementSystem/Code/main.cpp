@@ -6,10 +6,12 @@
 #include "Staff.h"
 #include "Borrowing.h"
 #include "Reservation.h"
+#include "Page.h"
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <limits>
+#include <sstream>
 
 using namespace std;
 
@@ -42,6 +44,12 @@ void displayMenu() {
     cout << "15. Update Overdue Books\n";
     cout << "16. Calculate Overdue Fines\n";
     cout << "17. Test Connection\n";
+    cout << "18. Return Books (Drop-box Batch)\n";
+    cout << "19. Check Out Several Books\n";
+    cout << "20. Operation Statistics\n";
+    cout << "21. Query Statistics\n";
+    cout << "22. Start/Stop Tracing\n";
+    cout << "23. Metrics (Prometheus)\n";
     cout << "0.  Exit\n";
     cout << "════════════════════════════════════════\n";
     cout << "Enter choice: ";
@@ -85,11 +93,14 @@ double getDouble(const string& prompt) {
     }
 }
 
+const int BOOKS_PER_PAGE = 20;
+
 void displayAllBooks(DBManager& db) {
     cout << "\n=== ALL BOOKS ===\n";
-    vector<Book> books = db.getAllBooks();
+    TraceSpan span(db.getTracer(), "displayAllBooks");
+    Page<Book, BookCursor> page = db.getBooksPage(BookCursor(), BOOKS_PER_PAGE);
     
-    if (books.empty()) {
+    if (page.items.empty()) {
         cout << "No books found.\n";
         return;
     }
@@ -99,20 +110,31 @@ void displayAllBooks(DBManager& db) {
          << setw(15) << "Category" << setw(10) << "Available\n";
     cout << string(98, '-') << "\n";
     
-    for (const auto& book : books) {
-        cout << left << setw(5) << book.bookId 
-             << setw(18) << book.isbn.substr(0, 17)
-             << setw(30) << book.title.substr(0, 29)
-             << setw(20) << book.author.substr(0, 19)
-             << setw(15) << book.categoryName.substr(0, 14)
-             << setw(10) << (to_string(book.availableCopies) + "/" + to_string(book.totalCopies))
-             << "\n";
-    }
-    cout << "\nTotal: " << books.size() << " books\n";
+    size_t shown = 0;
+    while (true) {
+        for (const auto& book : page.items) {
+            cout << left << setw(5) << book.bookId 
+                 << setw(18) << book.isbn.substr(0, 17)
+                 << setw(30) << book.title.substr(0, 29)
+                 << setw(20) << book.author.substr(0, 19)
+                 << setw(15) << book.categoryName.substr(0, 14)
+                 << setw(10) << (to_string(book.availableCopies) + "/" + to_string(book.totalCopies))
+                 << "\n";
+        }
+        shown += page.items.size();
+        
+        if (!page.hasMore) break;
+        span.end();   // the wait for Enter is not part of the operation
+        string more = getLine("-- Enter for next page, q to stop -- ");
+        if (!more.empty() && (more[0] == 'q' || more[0] == 'Q')) break;
+        page = db.getBooksPage(page.next, BOOKS_PER_PAGE);
+    }
+    cout << "\nShown: " << shown << " books\n";
 }
 
 void displayAvailableBooks(DBManager& db) {
     cout << "\n=== AVAILABLE BOOKS ===\n";
+    TraceSpan span(db.getTracer(), "displayAvailableBooks");
     vector<Book> books = db.getAvailableBooks();
     
     if (books.empty()) {
@@ -130,6 +152,7 @@ void searchBooks(DBManager& db) {
     string title = getLine("Enter book title to search: ");
     
     cout << "\n=== SEARCH RESULTS ===\n";
+    TraceSpan span(db.getTracer(), "searchBooks");
     vector<Book> books = db.searchBooksByTitle(title);
     
     if (books.empty()) {
@@ -168,6 +191,7 @@ void addNewBook(DBManager& db) {
     double price = getDouble("Price: ");
     string shelfLocation = getLine("Shelf Location: ");
     
+    TraceSpan span(db.getTracer(), "addNewBook");
     if (db.createBook(isbn, title, author, publisher, year, categoryId, 
                       totalCopies, price, shelfLocation)) {
         cout << "✓ Book added successfully!\n";
@@ -178,6 +202,7 @@ void addNewBook(DBManager& db) {
 
 void displayAllMembers(DBManager& db) {
     cout << "\n=== ALL MEMBERS ===\n";
+    TraceSpan span(db.getTracer(), "displayAllMembers");
     vector<Member> members = db.getAllMembers();
     
     if (members.empty()) {
@@ -207,6 +232,7 @@ void addNewMember(DBManager& db) {
     string phone = getLine("Phone: ");
     string address = getLine("Address: ");
     
+    TraceSpan span(db.getTracer(), "addNewMember");
     if (db.createMember(firstName, lastName, email, phone, address)) {
         cout << "✓ Member added successfully!\n";
     } else {
@@ -216,6 +242,7 @@ void addNewMember(DBManager& db) {
 
 void displayAllStaff(DBManager& db) {
     cout << "\n=== ALL STAFF ===\n";
+    TraceSpan span(db.getTracer(), "displayAllStaff");
     vector<Staff> staffList = db.getAllStaff();
     
     if (staffList.empty()) {
@@ -231,6 +258,7 @@ void displayAllStaff(DBManager& db) {
 
 void displayAllCategories(DBManager& db) {
     cout << "\n=== ALL CATEGORIES ===\n";
+    TraceSpan span(db.getTracer(), "displayAllCategories");
     vector<Category> categories = db.getAllCategories();
     
     if (categories.empty()) {
@@ -252,15 +280,54 @@ void createBorrowing(DBManager& db) {
     int staffId = getInt("Staff ID: ");
     string dueDate = getLine("Due Date (YYYY-MM-DD): ");
     
-    if (db.createBorrowing(bookId, memberId, staffId, dueDate)) {
-        cout << "✓ Borrowing created successfully!\n";
+    TraceSpan span(db.getTracer(), "createBorrowing");
+    CheckoutResult result = db.checkoutBook(bookId, memberId, staffId, dueDate);
+    if (result.ok()) {
+        cout << "✓ Borrowing created successfully! (Borrowing ID: " << result.borrowingId << ")\n";
     } else {
-        cout << "✗ Failed to create borrowing.\n";
+        cout << "✗ Failed to create borrowing: " << checkoutStatusMessage(result.status) << "\n";
     }
 }
 
+void createBorrowingsBatch(DBManager& db) {
+    cout << "\n=== CHECK OUT SEVERAL BOOKS ===\n";
+    
+    int memberId = getInt("Member ID: ");
+    int staffId = getInt("Staff ID: ");
+    istringstream line(getLine("Book IDs (separated by spaces): "));
+    vector<int> bookIds;
+    int id;
+    while (line >> id) {
+        bookIds.push_back(id);
+    }
+    if (bookIds.empty()) {
+        cout << "No book IDs entered.\n";
+        return;
+    }
+    string dueDate = getLine("Due Date (YYYY-MM-DD): ");
+    string partial = getLine("Check out the available ones if some fail? (y/n): ");
+    BatchMode mode = (partial == "y" || partial == "Y") ? BatchMode::BestEffort
+                                                        : BatchMode::AllOrNothing;
+    
+    TraceSpan span(db.getTracer(), "createBorrowingsBatch");
+    vector<CheckoutResult> results = db.createBorrowings(memberId, staffId, bookIds, dueDate, mode);
+    size_t checkedOut = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const CheckoutResult& result = results[i];
+        cout << left << setw(8) << bookIds[i];
+        if (result.ok()) {
+            ++checkedOut;
+            cout << "✓ Borrowing ID: " << result.borrowingId << "\n";
+        } else {
+            cout << "✗ " << checkoutStatusMessage(result.status) << "\n";
+        }
+    }
+    cout << "\nChecked out: " << checkedOut << " of " << results.size() << "\n";
+}
+
 void displayAllBorrowings(DBManager& db) {
     cout << "\n=== ALL BORROWINGS ===\n";
+    TraceSpan span(db.getTracer(), "displayAllBorrowings");
     vector<Borrowing> borrowings = db.getAllBorrowings();
     
     if (borrowings.empty()) {
@@ -276,6 +343,7 @@ void displayAllBorrowings(DBManager& db) {
 
 void displayCurrentBorrowings(DBManager& db) {
     cout << "\n=== CURRENT BORROWINGS ===\n";
+    TraceSpan span(db.getTracer(), "displayCurrentBorrowings");
     vector<Borrowing> borrowings = db.getCurrentBorrowings();
     
     if (borrowings.empty()) {
@@ -303,11 +371,50 @@ void returnBook(DBManager& db) {
     
     int borrowingId = getInt("Borrowing ID: ");
     
-    if (db.returnBook(borrowingId)) {
+    TraceSpan span(db.getTracer(), "returnBook");
+    ReturnResult result = db.returnBorrowing(borrowingId);
+    if (result.ok()) {
         cout << "✓ Book returned successfully!\n";
+        if (result.fulfilledReservationId != 0) {
+            cout << "  Hold for reservation #" << result.fulfilledReservationId << "\n";
+        }
     } else {
-        cout << "✗ Failed to return book.\n";
+        cout << "✗ Failed to return book: " << returnStatusMessage(result.status) << "\n";
+    }
+}
+
+void returnBooksBatch(DBManager& db) {
+    cout << "\n=== RETURN BOOKS (DROP-BOX) ===\n";
+    
+    istringstream line(getLine("Borrowing IDs (separated by spaces): "));
+    vector<int> borrowingIds;
+    int id;
+    while (line >> id) {
+        borrowingIds.push_back(id);
+    }
+    if (borrowingIds.empty()) {
+        cout << "No borrowing IDs entered.\n";
+        return;
+    }
+    
+    TraceSpan span(db.getTracer(), "returnBooksBatch");
+    vector<ReturnResult> results = db.returnBooks(borrowingIds);
+    size_t returned = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const ReturnResult& result = results[i];
+        cout << left << setw(8) << borrowingIds[i];
+        if (result.ok()) {
+            ++returned;
+            cout << "✓ Returned";
+            if (result.fulfilledReservationId != 0) {
+                cout << " - hold for reservation #" << result.fulfilledReservationId;
+            }
+            cout << "\n";
+        } else {
+            cout << "✗ " << returnStatusMessage(result.status) << "\n";
+        }
     }
+    cout << "\nReturned: " << returned << " of " << results.size() << "\n";
 }
 
 void createReservation(DBManager& db) {
@@ -316,6 +423,7 @@ void createReservation(DBManager& db) {
     int bookId = getInt("Book ID: ");
     int memberId = getInt("Member ID: ");
     
+    TraceSpan span(db.getTracer(), "createReservation");
     if (db.createReservation(bookId, memberId)) {
         cout << "✓ Reservation created successfully!\n";
     } else {
@@ -325,6 +433,7 @@ void createReservation(DBManager& db) {
 
 void displayAllReservations(DBManager& db) {
     cout << "\n=== ALL RESERVATIONS ===\n";
+    TraceSpan span(db.getTracer(), "displayAllReservations");
     vector<Reservation> reservations = db.getAllReservations();
     
     if (reservations.empty()) {
@@ -341,6 +450,7 @@ void displayAllReservations(DBManager& db) {
 void updateOverdueBooks(DBManager& db) {
     cout << "\n=== UPDATE OVERDUE BOOKS ===\n";
     
+    TraceSpan span(db.getTracer(), "updateOverdueBooks");
     int count = db.executeUpdateOverdueBooks();
     if (count >= 0) {
         cout << "✓ Updated " << count << " overdue books.\n";
@@ -354,6 +464,7 @@ void calculateOverdueFines(DBManager& db) {
     
     double dailyRate = getDouble("Daily Fine Rate (default 1.00): ");
     
+    TraceSpan span(db.getTracer(), "calculateOverdueFines");
     int count = db.executeCalculateOverdueFines(dailyRate);
     if (count >= 0) {
         cout << "✓ Calculated fines for " << count << " borrowings.\n";
@@ -365,6 +476,7 @@ void calculateOverdueFines(DBManager& db) {
 void testConnection(DBManager& db) {
     cout << "\n=== TEST CONNECTION ===\n";
     
+    TraceSpan span(db.getTracer(), "testConnection");
     if (db.testConnection()) {
         cout << "✓ Connection is active and working!\n";
     } else {
@@ -372,6 +484,121 @@ void testConnection(DBManager& db) {
     }
 }
 
+// Microseconds as milliseconds, e.g. "12.3"
+string formatMillis(double micros) {
+    ostringstream out;
+    out << fixed << setprecision(1) << micros / 1000.0;
+    return out.str();
+}
+
+void displayOperationStats(DBManager& db) {
+    cout << "\n=== OPERATION STATISTICS (ms) ===\n";
+    vector<OperationSummary> stats = db.getOperationStats();
+    
+    if (stats.empty()) {
+        cout << "No operations recorded yet.\n";
+        return;
+    }
+    
+    cout << left << setw(30) << "Operation" << right << setw(7) << "Calls"
+         << setw(7) << "Errors" << setw(9) << "p50" << setw(9) << "p90"
+         << setw(9) << "p99" << setw(9) << "Max" << setw(9) << "Rows"
+         << setw(8) << "Trips" << "\n";
+    cout << string(97, '-') << "\n";
+    
+    for (const auto& op : stats) {
+        if (op.calls == 0) continue;
+        cout << left << setw(30) << op.operation.substr(0, 29) << right
+             << setw(7) << op.calls << setw(7) << op.errors
+             << setw(9) << formatMillis(static_cast<double>(op.p50Micros))
+             << setw(9) << formatMillis(static_cast<double>(op.p90Micros))
+             << setw(9) << formatMillis(static_cast<double>(op.p99Micros))
+             << setw(9) << formatMillis(static_cast<double>(op.maxMicros))
+             << setw(9) << op.rows << setw(8) << op.roundTrips << "\n";
+    }
+    
+    string reset = getLine("\nReset the statistics? (y/n): ");
+    if (!reset.empty() && (reset[0] == 'y' || reset[0] == 'Y')) {
+        db.resetOperationStats();
+        cout << "✓ Statistics reset.\n";
+    }
+}
+
+void displayQueryStats(DBManager& db) {
+    cout << "\n=== QUERY STATISTICS (top 10 by total time, ms) ===\n";
+    vector<QuerySummary> stats = db.getQueryStats();
+    
+    if (stats.empty()) {
+        cout << "No statements recorded yet.\n";
+        return;
+    }
+    
+    cout << right << setw(7) << "Calls" << setw(10) << "Total" << setw(9) << "Mean"
+         << setw(9) << "Max" << setw(8) << "Rows" << setw(7) << "Errors" << "  "
+         << left << "Query\n";
+    cout << string(110, '-') << "\n";
+    
+    for (size_t i = 0; i < stats.size() && i < 10; ++i) {
+        const QuerySummary& query = stats[i];
+        cout << right << setw(7) << query.calls
+             << setw(10) << formatMillis(static_cast<double>(query.totalMicros))
+             << setw(9) << formatMillis(query.meanMicros())
+             << setw(9) << formatMillis(static_cast<double>(query.maxMicros))
+             << setw(8) << query.rows << setw(7) << query.errors << "  "
+             << left << query.fingerprint.substr(0, 58) << "\n";
+    }
+    cout << "\nTotal: " << stats.size() << " distinct queries\n";
+    
+    string path = getLine("\nExport to file (blank to skip; .json for JSON, else CSV): ");
+    if (path.empty()) return;
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (db.exportQueryStats(path, json ? QueryStatsFormat::Json : QueryStatsFormat::Csv)) {
+        cout << "✓ Written to " << path << "\n";
+    } else {
+        cout << "✗ Could not write " << path << "\n";
+    }
+}
+
+void toggleTracing(DBManager& db) {
+    cout << "\n=== TRACING ===\n";
+    
+    if (db.getTracer().isActive()) {
+        db.stopTrace();
+        cout << "✓ Tracing stopped. Open the file in chrome://tracing or https://ui.perfetto.dev\n";
+        return;
+    }
+    
+    string path = getLine("Trace file (default library_trace.json): ");
+    if (path.empty()) path = "library_trace.json";
+    if (db.startTrace(path)) {
+        cout << "✓ Tracing to " << path << " until this option is chosen again or the program exits.\n";
+    } else {
+        cout << "✗ Could not create " << path << "\n";
+    }
+}
+
+void displayMetrics(DBManager& db) {
+    cout << "\n=== METRICS (Prometheus text format) ===\n";
+    cout << db.getMetricsText();
+    
+    if (db.isExportingMetrics()) {
+        string stop = getLine("\nStop writing the metrics file? (y/n): ");
+        if (stop == "y" || stop == "Y") {
+            db.stopMetricsExport();
+            cout << "✓ Metrics export stopped.\n";
+        }
+        return;
+    }
+    
+    string path = getLine("\nWrite to a file every 15 s for node_exporter (blank to skip, e.g. library.prom): ");
+    if (path.empty()) return;
+    if (db.startMetricsExport(path)) {
+        cout << "✓ Writing " << path << " until this option is used to stop it or the program exits.\n";
+    } else {
+        cout << "✗ Could not write " << path << "\n";
+    }
+}
+
 int main() {
     cout << "╔═════════════════════════════════════════════╗\n";
     cout << "║   LIBRARY MANAGEMENT SYSTEM - SQL SERVER   ║\n";
@@ -439,6 +666,12 @@ int main() {
                 case 15: updateOverdueBooks(db); break;
                 case 16: calculateOverdueFines(db); break;
                 case 17: testConnection(db); break;
+                case 18: returnBooksBatch(db); break;
+                case 19: createBorrowingsBatch(db); break;
+                case 20: displayOperationStats(db); break;
+                case 21: displayQueryStats(db); break;
+                case 22: toggleTracing(db); break;
+                case 23: displayMetrics(db); break;
                 case 0: cout << "\nExiting... Goodbye!\n"; break;
                 default: cout << "Invalid choice. Try again.\n";
             }